@@ -10,9 +10,12 @@
 #include "lv_conf.h"
 #include "lv_drv_conf.h"
 #include "lv_drivers/sdl/sdl.h"
+#include "profiler.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
 
 /*********************
  *      DEFINES
@@ -35,12 +38,22 @@ static lv_disp_drv_t g_disp_drv;
 /* Configuration */
 static graphic_config_t g_config;
 
+/* Render request notification (UI thread -> main loop) */
+static pthread_mutex_t g_render_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_render_cond;
+static bool g_render_requested = false;
+
+/* Capture time of the audio behind the pending redraw, 0 if none (latency probe) */
+static uint64_t g_pending_capture_ns = 0;
+
 /**********************
  *  STATIC PROTOTYPES
  **********************/
 static graphic_result_t graphic_init_lvgl(void);
 static graphic_result_t graphic_init_display(void);
 static graphic_result_t graphic_init_input_devices(void);
+static void graphic_init_render_sync(void);
+static void graphic_flush(lv_disp_drv_t* drv, const lv_area_t* area, lv_color_t* color_p);
 static void graphic_cleanup(void);
 
 /**********************
@@ -66,6 +79,9 @@ graphic_result_t graphic_init_with_config(const graphic_config_t* config)
     /* Store configuration */
     memcpy(&g_config, config, sizeof(graphic_config_t));
     
+    /* Initialize render request notification */
+    graphic_init_render_sync();
+    
     /* Initialize LVGL */
     graphic_result_t result = graphic_init_lvgl();
     if (result != GRAPHIC_OK) {
@@ -100,6 +116,7 @@ graphic_config_t graphic_get_default_config(void)
         .hor_res = GRAPHIC_HOR_RES,
         .ver_res = GRAPHIC_VER_RES,
         .color_depth = GRAPHIC_COLOR_DEPTH,
+        .max_fps = GRAPHIC_MAX_FPS,
     };
     return config;
 }
@@ -124,14 +141,22 @@ lv_disp_t* graphic_get_display(void)
     return g_display;
 }
 
-void graphic_task_handler(void)
+uint16_t graphic_get_max_fps(void)
+{
+    return g_config.max_fps;
+}
+
+uint32_t graphic_task_handler(void)
 {
     if (!g_graphic_initialized) {
-        return;
+        return GRAPHIC_TASK_PERIOD_MS;
     }
     
     /* Handle LVGL tasks */
-    lv_timer_handler();
+    uint64_t prof_start = prof_begin();
+    uint32_t idle_ms = lv_timer_handler();
+    prof_end(PROF_STAGE_RENDER, prof_start);
+    return idle_ms;
 }
 
 void graphic_refresh(void)
@@ -144,6 +169,55 @@ void graphic_refresh(void)
     lv_obj_invalidate(lv_scr_act());
 }
 
+void graphic_render_now(void)
+{
+    if (!g_graphic_initialized || g_display == NULL) {
+        return;
+    }
+    
+    /* Flush pending invalidations now instead of on the next refresh period */
+    uint64_t prof_start = prof_begin();
+    lv_refr_now(g_display);
+    prof_end(PROF_STAGE_RENDER, prof_start);
+}
+
+void graphic_request_render(void)
+{
+    pthread_mutex_lock(&g_render_mutex);
+    g_render_requested = true;
+    pthread_cond_signal(&g_render_cond);
+    pthread_mutex_unlock(&g_render_mutex);
+}
+
+void graphic_set_frame_capture_ns(uint64_t capture_ns)
+{
+    __atomic_store_n(&g_pending_capture_ns, capture_ns, __ATOMIC_RELAXED);
+}
+
+bool graphic_wait_render_request(uint32_t timeout_ms)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    
+    pthread_mutex_lock(&g_render_mutex);
+    while (!g_render_requested) {
+        if (pthread_cond_timedwait(&g_render_cond, &g_render_mutex, &deadline) != 0) {
+            break;
+        }
+    }
+    bool requested = g_render_requested;
+    g_render_requested = false;
+    pthread_mutex_unlock(&g_render_mutex);
+    
+    return requested;
+}
+
 /**********************
  *   STATIC FUNCTIONS
  **********************/
@@ -178,7 +252,7 @@ static graphic_result_t graphic_init_display(void)
     g_disp_drv.draw_buf = &g_disp_buffer;
     
     /* Set flush callback */
-    g_disp_drv.flush_cb = sdl_display_flush;
+    g_disp_drv.flush_cb = graphic_flush;
     
     /* Register display driver */
     g_display = lv_disp_drv_register(&g_disp_drv);
@@ -215,6 +289,31 @@ static graphic_result_t graphic_init_input_devices(void)
     return GRAPHIC_OK;
 }
 
+static void graphic_init_render_sync(void)
+{
+    /* Use the monotonic clock so wall-clock jumps do not stall the render loop */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_render_cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void graphic_flush(lv_disp_drv_t* drv, const lv_area_t* area, lv_color_t* color_p)
+{
+    /* SDL flush, timed for the profiler */
+    bool last = lv_disp_flush_is_last(drv);
+    uint64_t prof_start = prof_begin();
+    sdl_display_flush(drv, area, color_p);
+    prof_end(PROF_STAGE_FLUSH, prof_start);
+
+    /* The SDL window is updated on the last flush of a refresh: the audio is now on screen */
+    if (last && prof_start) {
+        uint64_t capture_ns = __atomic_exchange_n(&g_pending_capture_ns, 0, __ATOMIC_RELAXED);
+        if (capture_ns) prof_record(PROF_STAGE_PHOTON_SDL, capture_ns, prof_now_ns());
+    }
+}
+
 static void graphic_cleanup(void)
 {
     /* Free display buffers */
@@ -24,6 +24,7 @@ extern "C" {
 #define GRAPHIC_HOR_RES     1280
 #define GRAPHIC_VER_RES     720
 #define GRAPHIC_COLOR_DEPTH 32
+#define GRAPHIC_MAX_FPS     60      /* Visualizer frame-rate cap, 0 = uncapped */
 
 
 #ifndef PROJECT_PATH
@@ -56,6 +57,7 @@ typedef struct {
     uint16_t hor_res;           /**< Horizontal resolution */
     uint16_t ver_res;           /**< Vertical resolution */
     uint8_t  color_depth;       /**< Color depth in bits */
+    uint16_t max_fps;           /**< Visualizer frame-rate cap, 0 = uncapped */
 } graphic_config_t;
 
 /**********************
@@ -98,17 +100,48 @@ bool graphic_is_initialized(void);
  */
 lv_disp_t* graphic_get_display(void);
 
+/**
+ * @brief Get the configured visualizer frame-rate cap
+ * @return Maximum frames per second, 0 if uncapped
+ */
+uint16_t graphic_get_max_fps(void);
+
 /**
  * @brief Run graphics task (should be called periodically)
  * This function handles LVGL timer tasks and should be called in main loop
+ * @return Time in ms until the handler needs to run again
  */
-void graphic_task_handler(void);
+uint32_t graphic_task_handler(void);
 
 /**
  * @brief Force screen refresh
  */
 void graphic_refresh(void);
 
+/**
+ * @brief Redraw invalidated areas immediately instead of waiting for the refresh timer
+ */
+void graphic_render_now(void);
+
+/**
+ * @brief Notify the render loop that new content is ready (thread-safe)
+ */
+void graphic_request_render(void);
+
+/**
+ * @brief Sleep until graphic_request_render() is called or the timeout expires
+ * @param timeout_ms Maximum time to wait in ms
+ * @return true if a render was requested, false on timeout
+ */
+bool graphic_wait_render_request(uint32_t timeout_ms);
+
+/**
+ * @brief Tag the content drawn since the last flush with the capture time of its audio
+ * The next completed flush records the audio-to-photon latency (PROF_STAGE_PHOTON_SDL)
+ * @param capture_ns CLOCK_MONOTONIC capture time of the newest sample shown
+ */
+void graphic_set_frame_capture_ns(uint64_t capture_ns);
+
 /**********************
  *      MACROS
  **********************/
@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 #include <graphic.h>
 
 // Forward declaration
@@ -30,6 +31,30 @@ static int prev_bass = 0;
 static int prev_mid = 0;
 static int prev_treble = 0;
 
+// --- NGƯỠNG CẬP NHẬT ---
+// Arc chỉ vẽ lại khi giá trị lệch >= ARC_VALUE_STEP (hoặc chạm 0/100)
+#define ARC_VALUE_STEP 2
+
+// Giá trị đang hiển thị (-1: chưa đặt)
+static int shown_bass = -1;
+static int shown_mid = -1;
+static int shown_treble = -1;
+static int shown_glow = -1;
+
+// --- SPRITE LÕI PHÁT SÁNG ---
+// LV_SHADOW_CACHE_SIZE = 0: mỗi lần đổi shadow_width LVGL phải blur lại bóng.
+// Thay vào đó dựng sẵn GLOW_LEVELS ảnh lõi + quầng sáng (ARGB) lúc init
+// và chỉ đổi src theo chỉ số mức.
+#define GLOW_LEVELS 12
+#define CORE_RADIUS 30                      // lõi 60x60 như trước
+#define GLOW_MAX_SHADOW (20 + 100 / 2)      // shadow_width ứng với bass = 100
+#define GLOW_SIZE (2 * (CORE_RADIUS + GLOW_MAX_SHADOW / 2 + 1))
+
+static lv_img_dsc_t glow_dsc[GLOW_LEVELS];
+static uint8_t *glow_buf[GLOW_LEVELS];
+
+static void free_glow_sprites(void);
+
 // --- HÀM BACK ---
 static void back_event_handler(lv_event_t *e)
 {
@@ -41,6 +66,9 @@ static void back_event_handler(lv_event_t *e)
 
     lv_obj_t * screen = lv_scr_act(); 
     lv_obj_clean(screen);
+    arc_cont = NULL;
+    core_glow = NULL;
+    free_glow_sprites();
 
     extern void mainpage_create(lv_obj_t *parent);
     mainpage_create(screen);
@@ -84,6 +112,94 @@ static void create_hud_label(lv_obj_t *parent, const char* text, int y_offset, l
     lv_obj_set_style_text_font(label, &lv_font_montserrat_14, 0); 
 }
 
+// Mức glow từ bass (0..100) -> 0..GLOW_LEVELS-1
+static int glow_level(int bass) {
+    int level = (bass * (GLOW_LEVELS - 1) + 50) / 100;
+    if (level < 0) level = 0;
+    if (level > GLOW_LEVELS - 1) level = GLOW_LEVELS - 1;
+    return level;
+}
+
+static void free_glow_sprites(void) {
+    for (int i = 0; i < GLOW_LEVELS; i++) {
+        free(glow_buf[i]);
+        glow_buf[i] = NULL;
+    }
+}
+
+// Dựng ảnh cho một mức: lõi trắng (bg_opa) trên quầng cyan có độ mờ tuyến tính
+// quanh mép lõi, rộng shadow_width (giống shadow của LVGL, không cần blur)
+static void build_glow_sprite(int level) {
+    int bass = level * 100 / (GLOW_LEVELS - 1);
+    float core_opa = (float)LV_MIN(100 + bass * 3 / 2, 255) / 255.0f;
+    float shadow_w = (float)(20 + bass / 2);
+
+    lv_color_t white = lv_color_hex(0xFFFFFF);
+    lv_color_t cyan = lv_color_hex(0x00FFFF);
+    float center = (GLOW_SIZE - 1) * 0.5f;
+
+    for (int y = 0; y < GLOW_SIZE; y++) {
+        for (int x = 0; x < GLOW_SIZE; x++) {
+            float dx = x - center;
+            float dy = y - center;
+            float r = sqrtf(dx * dx + dy * dy);
+
+            // Bóng: 50% ở mép lõi, tắt dần trong shadow_w/2 mỗi phía
+            float shadow = 0.5f - (r - CORE_RADIUS) / shadow_w;
+            if (shadow < 0.0f) shadow = 0.0f;
+            if (shadow > 1.0f) shadow = 1.0f;
+
+            // Lõi: mép khử răng cưa 1px
+            float cover = CORE_RADIUS + 0.5f - r;
+            if (cover < 0.0f) cover = 0.0f;
+            if (cover > 1.0f) cover = 1.0f;
+            float core = core_opa * cover;
+
+            // Lõi đè lên bóng
+            float alpha = core + shadow * (1.0f - core);
+            lv_color_t color = cyan;
+            if (alpha > 0.0f && core > 0.0f) {
+                color = lv_color_mix(white, cyan, (lv_opa_t)(core / alpha * 255.0f));
+            }
+
+            uint8_t *px = glow_buf[level] + (y * GLOW_SIZE + x) * LV_IMG_PX_SIZE_ALPHA_BYTE;
+            memcpy(px, &color, sizeof(lv_color_t));
+            px[LV_IMG_PX_SIZE_ALPHA_BYTE - 1] = (uint8_t)(alpha * 255.0f + 0.5f);
+        }
+    }
+
+    glow_dsc[level].header.cf = LV_IMG_CF_TRUE_COLOR_ALPHA;
+    glow_dsc[level].header.always_zero = 0;
+    glow_dsc[level].header.reserved = 0;
+    glow_dsc[level].header.w = GLOW_SIZE;
+    glow_dsc[level].header.h = GLOW_SIZE;
+    glow_dsc[level].data_size = GLOW_SIZE * GLOW_SIZE * LV_IMG_PX_SIZE_ALPHA_BYTE;
+    glow_dsc[level].data = glow_buf[level];
+}
+
+static int build_glow_sprites(void) {
+    for (int i = 0; i < GLOW_LEVELS; i++) {
+        glow_buf[i] = (uint8_t *)malloc(GLOW_SIZE * GLOW_SIZE * LV_IMG_PX_SIZE_ALPHA_BYTE);
+        if (!glow_buf[i]) {
+            free_glow_sprites();
+            return -1;
+        }
+        build_glow_sprite(i);
+    }
+    return 0;
+}
+
+// Đặt giá trị arc khi lệch đủ ngưỡng
+static void arc_update(lv_obj_t *arc, int value, int *shown) {
+    int diff = value - *shown;
+    if (diff < 0) diff = -diff;
+    if (*shown >= 0 && diff < ARC_VALUE_STEP &&
+        !(value != *shown && (value == 0 || value == 100))) return;
+
+    lv_arc_set_value(arc, value);
+    *shown = value;
+}
+
 // --- INIT ---
 mv_page_err_code ArcReactor_sub_page_init(lv_obj_t *parent) {
     if (!parent) return MV_PAGE_RET_FAIL;
@@ -112,16 +228,13 @@ mv_page_err_code ArcReactor_sub_page_init(lv_obj_t *parent) {
     create_hud_label(arc_cont, "MID", 110, c_mid);     // Giữa
     create_hud_label(arc_cont, "TREBLE", 60, c_treble);// Trên cùng (gần lõi)
 
-    // 4. Lõi Core
-    core_glow = lv_obj_create(arc_cont);
-    lv_obj_set_size(core_glow, 60, 60); // Nhỏ lại chút để không che chữ Treble
-    lv_obj_set_style_radius(core_glow, LV_RADIUS_CIRCLE, 0);
-    lv_obj_set_style_bg_color(core_glow, lv_color_hex(0xFFFFFF), 0);
-    lv_obj_set_style_bg_opa(core_glow, LV_OPA_50, 0);
-    
-    // Hiệu ứng bóng
-    lv_obj_set_style_shadow_width(core_glow, 40, 0);
-    lv_obj_set_style_shadow_color(core_glow, lv_color_hex(0x00FFFF), 0);
+    // 4. Lõi Core: ảnh dựng sẵn (lõi 60x60 + quầng sáng), đổi theo mức bass
+    if (build_glow_sprites() != 0) return MV_PAGE_RET_FAIL;
+    shown_bass = shown_mid = shown_treble = -1;
+    shown_glow = glow_level(prev_bass);
+
+    core_glow = lv_img_create(arc_cont);
+    lv_img_set_src(core_glow, &glow_dsc[shown_glow]);
     lv_obj_center(core_glow);
 
     // Nút Back
@@ -148,24 +261,18 @@ mv_page_err_code ArcReactor_sub_page_deinit(void) {
         arc_treble = NULL;
         core_glow = NULL;
     }
+    free_glow_sprites();
     return MV_PAGE_RET_OK;
 }
 
 // --- UPDATE ---
 mv_page_err_code ArcReactor_sub_page_main_function(mv_value_t *value) {
-    if (!arc_cont || !value || !value->value) return MV_PAGE_RET_FAIL;
-
-    float bass_sum = 0, mid_sum = 0, treble_sum = 0;
-    
-    // Chia dải tần
-    for(int i=0; i<10; i++) bass_sum += fabsf(value->value[i]);
-    bass_sum /= 10.0f;
-
-    for(int i=10; i<60; i++) mid_sum += fabsf(value->value[i]);
-    mid_sum /= 50.0f;
+    if (!arc_cont || !value || !value->frame) return MV_PAGE_RET_FAIL;
 
-    for(int i=60; i<150; i++) treble_sum += fabsf(value->value[i]);
-    treble_sum /= 90.0f;
+    // Chia dải tần: bass/mid/treble tính sẵn trên DSP thread (bin 0-10 / 10-60 / 60-150)
+    float bass_sum = value->frame->features.bass;
+    float mid_sum = value->frame->features.mid;
+    float treble_sum = value->frame->features.treble;
 
     // Tính % (Sensitivity chỉnh ở đây)
     // Với tín hiệu ~60-80, hệ số 1.5 -> 1.8 là đẹp
@@ -182,16 +289,17 @@ mv_page_err_code ArcReactor_sub_page_main_function(mv_value_t *value) {
     prev_mid = prev_mid * 0.8f + target_mid * 0.2f;
     prev_treble = prev_treble * 0.5f + target_treble * 0.5f;
 
-    // Update UI
-    lv_arc_set_value(arc_bass, prev_bass);
-    lv_arc_set_value(arc_mid, prev_mid);
-    lv_arc_set_value(arc_treble, prev_treble);
+    // Update UI (bỏ qua khi giá trị không đổi đáng kể)
+    arc_update(arc_bass, prev_bass, &shown_bass);
+    arc_update(arc_mid, prev_mid, &shown_mid);
+    arc_update(arc_treble, prev_treble, &shown_treble);
 
-    // Core Effect
-    int opa_val = 100 + (prev_bass * 1.5);
-    if (opa_val > 255) opa_val = 255;
-    lv_obj_set_style_bg_opa(core_glow, (lv_opa_t)opa_val, 0);
-    lv_obj_set_style_shadow_width(core_glow, 20 + (prev_bass / 2), 0);
+    // Core Effect: chỉ đổi sprite khi sang mức khác
+    int level = glow_level(prev_bass);
+    if (level != shown_glow) {
+        lv_img_set_src(core_glow, &glow_dsc[level]);
+        shown_glow = level;
+    }
 
     return MV_PAGE_RET_OK;
 }
@@ -1,4 +1,5 @@
 #include "mvpage.h"
+#include "canvas_util.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -6,8 +7,24 @@
 #include <graphic.h>
 #include <lvgl/lvgl.h>
 
+#define BARS_GAP 1
+#define BARS_BG_COLOR lv_color_hex(0xffffff)
+
 static void back_button_event_cb(lv_event_t *e);
 
+// Kích thước canvas của các cột (tính trong init)
+static int32_t bar_w = 0;
+static int32_t canvas_w = 0;
+static int32_t canvas_h = 0;
+
+// Tô/xóa các hàng [from, to) của một cột, ghi thẳng vào buffer của canvas
+static void bars_fill_rows(lv_color_t *column, int32_t from, int32_t to, lv_color_t color) {
+    for (int32_t y = from; y < to; y++) {
+        lv_color_t *px = column + y * canvas_w;
+        for (int32_t x = 0; x < bar_w; x++) px[x] = color;
+    }
+}
+
 mv_page_err_code MusicVisualizerTest_sub_page_init(lv_obj_t *parent){
     if (!MusicVisualizerPage || !parent) return MV_PAGE_RET_FAIL;
 
@@ -116,21 +133,28 @@ mv_page_err_code MusicVisualizerTest_sub_page_init(lv_obj_t *parent){
     int32_t bar_height_max = GRAPHIC_VER_RES - 250;  
     printf("Container width: %d, Bar width: %d, Bar height max: %d\n", bars_width, bar_width, bar_height_max);
 
+    // Một canvas cho cả BAR_NUMBER cột thay vì BAR_NUMBER lv_obj:
+    // mỗi frame chỉ ghi lại các hàng pixel thay đổi và invalidate đúng các vùng đó
+    bar_w = bar_width;
+    canvas_w = BAR_NUMBER * (bar_width + BARS_GAP) - BARS_GAP;
+    canvas_h = bar_height_max;
+
+    if (music_subpage->bars_cbuf) free(music_subpage->bars_cbuf);
+    music_subpage->bars_cbuf = (lv_color_t *)malloc(LV_CANVAS_BUF_SIZE_TRUE_COLOR(canvas_w, canvas_h));
+    if (!music_subpage->bars_cbuf) return MV_PAGE_RET_FAIL;
+
+    lv_obj_t *bars_canvas = lv_canvas_create(main_container);
+    lv_canvas_set_buffer(bars_canvas, music_subpage->bars_cbuf, canvas_w, canvas_h, LV_IMG_CF_TRUE_COLOR);
+    lv_canvas_fill_bg(bars_canvas, BARS_BG_COLOR, LV_OPA_COVER);
+    lv_obj_set_pos(bars_canvas, 0, (GRAPHIC_VER_RES - 40)/2 - bar_height_max/2);
+    lv_obj_move_background(bars_canvas);   // title + back button vẫn nằm trên
+    music_subpage->bars_canvas = bars_canvas;
+
     for (int i = 0; i < BAR_NUMBER; i++) {
-        music_subpage->music_bar[i] = lv_obj_create(main_container);
-        lv_obj_set_size(music_subpage->music_bar[i], bar_width, 10); 
-        
-        int32_t x_pos = i * (bar_width + 1);  // 1px gap
-        lv_obj_set_pos(music_subpage->music_bar[i], x_pos, bar_height_max - bar_height_max/2 - 10);
-        
-        lv_obj_set_style_bg_color(music_subpage->music_bar[i], lv_color_hex(0x00ff00), 0);
-        lv_obj_set_style_border_width(music_subpage->music_bar[i], 0, 0);
-        lv_obj_set_style_radius(music_subpage->music_bar[i], 3, 0);
-        lv_obj_clear_flag(music_subpage->music_bar[i], LV_OBJ_FLAG_SCROLLABLE);
-        
         float hue = (1.0f - (float)i / (BAR_NUMBER - 1)) * 300.0f; 
-        uint32_t color = lv_color_hsv_to_rgb((uint16_t)hue, 100, 100).full;
-        lv_obj_set_style_bg_color(music_subpage->music_bar[i], lv_color_hex(color), 0);
+        music_subpage->bar_color[i] = lv_color_hsv_to_rgb((uint16_t)hue, 100, 100);
+        music_subpage->bar_top[i] = (int16_t)(canvas_h/2);
+        music_subpage->bar_bottom[i] = (int16_t)(canvas_h/2);
     }
 /* ---------------------------------------------------------------------------------
 * End Setup 
@@ -150,8 +174,13 @@ mv_page_err_code MusicVisualizerTest_sub_page_deinit(void){
         music_subpage->base.container = NULL;
         music_subpage->base.back_container = NULL;
         music_subpage->base.title_label = NULL;
+        music_subpage->bars_canvas = NULL;
         music_subpage->base.state = MV_PAGE_IDLE;
     }
+    if (music_subpage->bars_cbuf) {
+        free(music_subpage->bars_cbuf);
+        music_subpage->bars_cbuf = NULL;
+    }
 
     //MusicVisualizerPage = NULL;
 
@@ -167,21 +196,46 @@ mv_page_err_code MusicVisualizerTest_sub_page_main_function(mv_value_t *value){
 * User Functions for Visualizer Page 
 * ---------------------------------------------------------------------------------*/
 
+    if (!music_subpage->bars_canvas || !value || !value->value) return MV_PAGE_RET_FAIL;
+
     int32_t container_height = lv_obj_get_height(music_subpage->base.container) - 40;
-    int32_t bar_height_max = GRAPHIC_VER_RES - 250;;
+    int32_t bar_height_max = canvas_h;
+    canvas_dirty_t dirty;
+    canvas_dirty_reset(&dirty);
 
     for (int i = 0; i < BAR_NUMBER; i++) {
-        if (music_subpage->music_bar[i]) {
-            value->value[i] /= 100.0f;
-            
-            int32_t bar_height = (int32_t)(value->value[i] * (container_height/2));
-            if (bar_height < 5) bar_height = 5; 
-            bar_height = bar_height > bar_height_max ? bar_height_max : bar_height;
-
-            lv_obj_set_height(music_subpage->music_bar[i], bar_height);
-            lv_obj_set_y(music_subpage->music_bar[i], container_height/2 - bar_height/2);
-        }
-    }    
+        // Scale locally: value->value is shared with the other consumers
+        float level = (i < value->length) ? value->value[i] / 100.0f : 0.0f;
+        
+        int32_t bar_height = (int32_t)(level * (container_height/2));
+        if (bar_height < 5) bar_height = 5; 
+        bar_height = bar_height > bar_height_max ? bar_height_max : bar_height;
+
+        int32_t top = canvas_h/2 - bar_height/2;
+        int32_t bottom = top + bar_height;
+        int32_t old_top = music_subpage->bar_top[i];
+        int32_t old_bottom = music_subpage->bar_bottom[i];
+        if (top == old_top && bottom == old_bottom) continue;
+
+        // Chỉ tô phần cột mới dài ra và xóa phần cột vừa thu lại
+        lv_color_t *column = music_subpage->bars_cbuf + i * (bar_w + BARS_GAP);
+        lv_color_t color = music_subpage->bar_color[i];
+        if (old_top < top)       bars_fill_rows(column, old_top, LV_MIN(old_bottom, top), BARS_BG_COLOR);
+        if (bottom < old_bottom) bars_fill_rows(column, LV_MAX(bottom, old_top), old_bottom, BARS_BG_COLOR);
+        if (top < old_top)       bars_fill_rows(column, top, LV_MIN(bottom, old_top), color);
+        if (old_bottom < bottom) bars_fill_rows(column, LV_MAX(old_bottom, top), bottom, color);
+
+        music_subpage->bar_top[i] = (int16_t)top;
+        music_subpage->bar_bottom[i] = (int16_t)bottom;
+
+        // Phần thay đổi nằm ở đầu và đuôi cột: hai vùng riêng để các đầu cột
+        // cạnh nhau gộp với nhau thay vì kéo theo cả thân cột
+        int32_t x = i * (bar_w + BARS_GAP);
+        canvas_dirty_add(&dirty, x, LV_MIN(top, old_top), x + bar_w - 1, LV_MAX(top, old_top) - 1);
+        canvas_dirty_add(&dirty, x, LV_MIN(bottom, old_bottom), x + bar_w - 1, LV_MAX(bottom, old_bottom) - 1);
+    }
+
+    canvas_dirty_invalidate(music_subpage->bars_canvas, &dirty);
 /* ---------------------------------------------------------------------------------
 * End Setup 
 * ---------------------------------------------------------------------------------*/
@@ -190,7 +244,8 @@ mv_page_err_code MusicVisualizerTest_sub_page_main_function(mv_value_t *value){
 }
 
 basic_musicvisual_mv_page_t BasicMusicVisualizerPage = {
-    .music_bar = {NULL},
+    .bars_canvas = NULL,
+    .bars_cbuf = NULL,
     .base = {
         .sub_page_init = MusicVisualizerTest_sub_page_init,
         .sub_page_deinit = MusicVisualizerTest_sub_page_deinit,
@@ -0,0 +1,122 @@
+#include "canvas_util.h"
+
+static int32_t area_size(const lv_area_t *a) {
+    return (int32_t)(a->x2 - a->x1 + 1) * (a->y2 - a->y1 + 1);
+}
+
+static void area_join(lv_area_t *dst, const lv_area_t *a, const lv_area_t *b) {
+    dst->x1 = LV_MIN(a->x1, b->x1);
+    dst->y1 = LV_MIN(a->y1, b->y1);
+    dst->x2 = LV_MAX(a->x2, b->x2);
+    dst->y2 = LV_MAX(a->y2, b->y2);
+}
+
+static int area_overlap(const lv_area_t *a, const lv_area_t *b) {
+    return a->x1 <= b->x2 && b->x1 <= a->x2 &&
+           a->y1 <= b->y2 && b->y1 <= a->y2;
+}
+
+void canvas_dirty_reset(canvas_dirty_t *dirty) {
+    dirty->count = 0;
+}
+
+void canvas_dirty_add(canvas_dirty_t *dirty, int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+    if (x2 < x1 || y2 < y1) return;
+
+    lv_area_t area = { (lv_coord_t)x1, (lv_coord_t)y1, (lv_coord_t)x2, (lv_coord_t)y2 };
+
+    // Giao nhau: gộp, rồi gộp tiếp nếu vùng mới lại giao vùng khác
+    for (int i = 0; i < dirty->count; i++) {
+        if (area_overlap(&dirty->rects[i], &area)) {
+            area_join(&area, &area, &dirty->rects[i]);
+            dirty->rects[i] = dirty->rects[--dirty->count];
+            i = -1;
+        }
+    }
+
+    if (dirty->count < CANVAS_DIRTY_MAX) {
+        dirty->rects[dirty->count++] = area;
+        return;
+    }
+
+    // Hết chỗ: gộp vào vùng làm tăng diện tích ít nhất
+    int best = 0;
+    int32_t best_growth = INT32_MAX;
+    for (int i = 0; i < dirty->count; i++) {
+        lv_area_t joined;
+        area_join(&joined, &dirty->rects[i], &area);
+        int32_t growth = area_size(&joined) - area_size(&dirty->rects[i]);
+        if (growth < best_growth) {
+            best_growth = growth;
+            best = i;
+        }
+    }
+    area_join(&dirty->rects[best], &dirty->rects[best], &area);
+}
+
+void canvas_dirty_invalidate(lv_obj_t *canvas, const canvas_dirty_t *dirty) {
+    if (!canvas || dirty->count == 0) return;
+
+    // lv_obj_invalidate_area() nhận tọa độ màn hình
+    lv_area_t coords;
+    lv_obj_get_coords(canvas, &coords);
+
+    for (int i = 0; i < dirty->count; i++) {
+        lv_area_t area = dirty->rects[i];
+        area.x1 += coords.x1;
+        area.x2 += coords.x1;
+        area.y1 += coords.y1;
+        area.y2 += coords.y1;
+        lv_obj_invalidate_area(canvas, &area);
+    }
+}
+
+void canvas_fill_rect(lv_color_t *cbuf, int32_t canvas_w, int32_t canvas_h,
+                      int32_t x, int32_t y, int32_t w, int32_t h, lv_color_t color) {
+    int32_t x1 = LV_MAX(x, 0);
+    int32_t y1 = LV_MAX(y, 0);
+    int32_t x2 = LV_MIN(x + w, canvas_w);
+    int32_t y2 = LV_MIN(y + h, canvas_h);
+    if (x2 <= x1 || y2 <= y1) return;
+
+    for (int32_t row = y1; row < y2; row++) {
+        lv_color_t *px = cbuf + row * canvas_w;
+        for (int32_t col = x1; col < x2; col++) px[col] = color;
+    }
+}
+
+void canvas_fill_rects(lv_color_t *cbuf, int32_t canvas_w, int32_t canvas_h,
+                       const lv_area_t *rects, const lv_color_t *colors, int count, lv_color_t color) {
+    for (int i = 0; i < count; i++) {
+        int32_t x1 = LV_MAX(rects[i].x1, 0);
+        int32_t y1 = LV_MAX(rects[i].y1, 0);
+        int32_t x2 = LV_MIN(rects[i].x2, canvas_w - 1);
+        int32_t y2 = LV_MIN(rects[i].y2, canvas_h - 1);
+        lv_color_t c = colors ? colors[i] : color;
+
+        for (int32_t row = y1; row <= y2; row++) {
+            lv_color_t *px = cbuf + row * canvas_w;
+            for (int32_t col = x1; col <= x2; col++) px[col] = c;
+        }
+    }
+}
+
+void canvas_fill_vspan(lv_color_t *cbuf, int32_t canvas_w, int32_t canvas_h,
+                       int32_t x, int32_t y1, int32_t y2, lv_color_t color) {
+    if (x < 0 || x >= canvas_w) return;
+    if (y1 < 0) y1 = 0;
+    if (y2 >= canvas_h) y2 = canvas_h - 1;
+
+    lv_color_t *px = cbuf + y1 * canvas_w + x;
+    for (int32_t row = y1; row <= y2; row++, px += canvas_w) *px = color;
+}
+
+void canvas_copy_vspan(lv_color_t *cbuf, const lv_color_t *src, int32_t canvas_w, int32_t canvas_h,
+                       int32_t x, int32_t y1, int32_t y2) {
+    if (x < 0 || x >= canvas_w) return;
+    if (y1 < 0) y1 = 0;
+    if (y2 >= canvas_h) y2 = canvas_h - 1;
+
+    int32_t offset = y1 * canvas_w + x;
+    for (int32_t row = y1; row <= y2; row++, offset += canvas_w) cbuf[offset] = src[offset];
+}
@@ -0,0 +1,52 @@
+#ifndef CANVAS_UTIL_H
+#define CANVAS_UTIL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <lvgl/lvgl.h>
+#include <stdint.h>
+
+// Số vùng dirty tối đa mỗi frame (LVGL chỉ giữ LV_INV_BUF_SIZE vùng,
+// vượt quá thì vẽ lại cả màn hình)
+#define CANVAS_DIRTY_MAX 16
+
+// Các vùng đã thay đổi của một canvas trong frame hiện tại.
+// Tọa độ tính theo canvas, x2/y2 là pixel cuối (inclusive) như lv_area_t.
+typedef struct canvas_dirty_t {
+    lv_area_t rects[CANVAS_DIRTY_MAX];
+    int count;
+} canvas_dirty_t;
+
+void canvas_dirty_reset(canvas_dirty_t *dirty);
+
+// Thêm một vùng; gộp với các vùng giao nhau, hết chỗ thì gộp vào vùng
+// làm tăng diện tích ít nhất.
+void canvas_dirty_add(canvas_dirty_t *dirty, int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+
+// lv_obj_invalidate_area() cho từng vùng thay vì lv_obj_invalidate() cả canvas
+void canvas_dirty_invalidate(lv_obj_t *canvas, const canvas_dirty_t *dirty);
+
+// Ghi thẳng vào buffer của canvas (LV_IMG_CF_TRUE_COLOR, stride = canvas_w),
+// cắt theo biên canvas. Không invalidate: gọi canvas_dirty_add()/invalidate sau.
+void canvas_fill_rect(lv_color_t *cbuf, int32_t canvas_w, int32_t canvas_h,
+                      int32_t x, int32_t y, int32_t w, int32_t h, lv_color_t color);
+
+// Tô nhiều ô trong một lượt: ô i dùng colors[i], hoặc `color` nếu colors == NULL
+void canvas_fill_rects(lv_color_t *cbuf, int32_t canvas_w, int32_t canvas_h,
+                       const lv_area_t *rects, const lv_color_t *colors, int count, lv_color_t color);
+
+// Tô cột x, các hàng [y1, y2] (inclusive)
+void canvas_fill_vspan(lv_color_t *cbuf, int32_t canvas_w, int32_t canvas_h,
+                       int32_t x, int32_t y1, int32_t y2, lv_color_t color);
+
+// Chép cột x, các hàng [y1, y2] từ src (cùng kích thước, vd. lớp nền dựng sẵn) sang cbuf
+void canvas_copy_vspan(lv_color_t *cbuf, const lv_color_t *src, int32_t canvas_w, int32_t canvas_h,
+                       int32_t x, int32_t y1, int32_t y2);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,12 +5,25 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 // --- CẤU HÌNH DEBUG ---
 // Đặt bằng 1 để bật chế độ GIẢ LẬP (Vòng tròn tự nhảy không cần nhạc)
 // Đặt bằng 0 để dùng chế độ THẬT (Nghe nhạc từ MusicProcessor)
 #define FAKE_MODE_ENABLE  0  
 
+// --- CẤU HÌNH ZOOM ---
+// Ảnh nền được phóng sẵn thành các mức (mip) 1.0x, 1.5x, 2.0x, 2.5x lúc init.
+// Mỗi frame chọn mức gần nhất rồi chỉ zoom phần dư (~0.8..1.25x) thay vì để
+// LVGL scale cả ảnh gốc lên tới 2.5x.
+#define CIRC_MIP_LEVELS   4
+#define CIRC_MIP_STEP     0.5f
+// 1: lọc song tuyến (mịn), 0: nearest-neighbour (rẻ hơn, răng cưa)
+// Áp dụng cho cả lúc dựng mip lẫn phần zoom dư của LVGL.
+#define CIRC_ANTIALIAS    1
+// Phần dư nhỏ hơn ngưỡng này thì bỏ zoom hẳn (LVGL vẽ ảnh thẳng, không transform)
+#define CIRC_ZOOM_SNAP    0.03f
+
 // 1. KHAI BÁO ẢNH 
 LV_IMG_DECLARE(circle_bg_png);
 LV_IMG_DECLARE(back_icon_png);
@@ -24,6 +37,108 @@ static lv_obj_t *circle_img = NULL;
 static lv_obj_t *back_btn = NULL;
 static float current_scale = 1.0f;
 
+// Mức 0 là chính circle_bg_png; các mức khác cấp phát lúc init
+static lv_img_dsc_t mip_dsc[CIRC_MIP_LEVELS];
+static uint8_t *mip_buf[CIRC_MIP_LEVELS];
+static int mip_count = 1;
+static int shown_level = -1;
+static int shown_zoom = -1;
+
+static void free_mip_levels(void) {
+    for (int i = 1; i < CIRC_MIP_LEVELS; i++) {
+        free(mip_buf[i]);
+        mip_buf[i] = NULL;
+    }
+    mip_count = 1;
+}
+
+// Đọc một pixel (màu + alpha) của ảnh đã giải mã
+static void mip_read_px(const uint8_t *data, int w, int px_size, int x, int y,
+                        lv_color_t *color, uint8_t *alpha) {
+    const uint8_t *px = data + (y * w + x) * px_size;
+    memcpy(color, px, sizeof(lv_color_t));
+    *alpha = (px_size == LV_IMG_PX_SIZE_ALPHA_BYTE) ? px[px_size - 1] : LV_OPA_COVER;
+}
+
+// Phóng ảnh nguồn (TRUE_COLOR hoặc TRUE_COLOR_ALPHA) theo scale vào dst cùng định dạng
+static void mip_resample(const uint8_t *src, int sw, int sh, uint8_t *dst, int dw, int dh,
+                         int px_size, float scale) {
+    for (int y = 0; y < dh; y++) {
+        float fy = (y + 0.5f) / scale - 0.5f;
+        for (int x = 0; x < dw; x++) {
+            float fx = (x + 0.5f) / scale - 0.5f;
+            lv_color_t color;
+            uint8_t alpha;
+
+#if CIRC_ANTIALIAS
+            int x0 = (int)floorf(fx), y0 = (int)floorf(fy);
+            int mx = (int)((fx - x0) * 255.0f), my = (int)((fy - y0) * 255.0f);
+            int x1 = LV_MIN(x0 + 1, sw - 1), y1 = LV_MIN(y0 + 1, sh - 1);
+            x0 = LV_MAX(x0, 0);
+            y0 = LV_MAX(y0, 0);
+
+            lv_color_t c00, c10, c01, c11;
+            uint8_t a00, a10, a01, a11;
+            mip_read_px(src, sw, px_size, x0, y0, &c00, &a00);
+            mip_read_px(src, sw, px_size, x1, y0, &c10, &a10);
+            mip_read_px(src, sw, px_size, x0, y1, &c01, &a01);
+            mip_read_px(src, sw, px_size, x1, y1, &c11, &a11);
+
+            // lv_color_mix(c1, c2, mix): mix = 255 -> c1
+            lv_color_t top = lv_color_mix(c10, c00, (lv_opa_t)mx);
+            lv_color_t bottom = lv_color_mix(c11, c01, (lv_opa_t)mx);
+            color = lv_color_mix(bottom, top, (lv_opa_t)my);
+            int a_top = (a00 * (255 - mx) + a10 * mx) / 255;
+            int a_bottom = (a01 * (255 - mx) + a11 * mx) / 255;
+            alpha = (uint8_t)((a_top * (255 - my) + a_bottom * my) / 255);
+#else
+            int sx = LV_MIN(LV_MAX((int)(fx + 0.5f), 0), sw - 1);
+            int sy = LV_MIN(LV_MAX((int)(fy + 0.5f), 0), sh - 1);
+            mip_read_px(src, sw, px_size, sx, sy, &color, &alpha);
+#endif
+
+            uint8_t *px = dst + (y * dw + x) * px_size;
+            memcpy(px, &color, sizeof(lv_color_t));
+            if (px_size == LV_IMG_PX_SIZE_ALPHA_BYTE) px[px_size - 1] = alpha;
+        }
+    }
+}
+
+// Dựng các mức 1..CIRC_MIP_LEVELS-1. Ảnh không giải mã được thành bitmap
+// TRUE_COLOR(_ALPHA) thì giữ một mức và zoom ảnh gốc như trước.
+static void build_mip_levels(void) {
+    mip_dsc[0] = circle_bg_png;
+    mip_count = 1;
+
+    lv_img_decoder_dsc_t dec;
+    if (lv_img_decoder_open(&dec, &circle_bg_png, lv_color_black(), 0) != LV_RES_OK) return;
+
+    int px_size = 0;
+    if (dec.header.cf == LV_IMG_CF_TRUE_COLOR) px_size = sizeof(lv_color_t);
+    else if (dec.header.cf == LV_IMG_CF_TRUE_COLOR_ALPHA) px_size = LV_IMG_PX_SIZE_ALPHA_BYTE;
+
+    if (dec.img_data && px_size) {
+        int sw = dec.header.w, sh = dec.header.h;
+        for (int i = 1; i < CIRC_MIP_LEVELS; i++) {
+            float scale = 1.0f + i * CIRC_MIP_STEP;
+            int dw = (int)(sw * scale + 0.5f), dh = (int)(sh * scale + 0.5f);
+
+            mip_buf[i] = (uint8_t *)malloc((size_t)dw * dh * px_size);
+            if (!mip_buf[i]) break;
+            mip_resample(dec.img_data, sw, sh, mip_buf[i], dw, dh, px_size, scale);
+
+            mip_dsc[i].header = dec.header;
+            mip_dsc[i].header.w = dw;
+            mip_dsc[i].header.h = dh;
+            mip_dsc[i].data_size = (uint32_t)dw * dh * px_size;
+            mip_dsc[i].data = mip_buf[i];
+            mip_count = i + 1;
+        }
+    }
+
+    lv_img_decoder_close(&dec);
+}
+
 // --- SỰ KIỆN BACK ---
 static void back_event_handler(lv_event_t *e)
 {
@@ -58,11 +173,16 @@ mv_page_err_code Circular_sub_page_init(lv_obj_t *parent) {
     lv_obj_set_style_bg_color(circ_cont, lv_color_hex(0x000000), 0);
     lv_obj_clear_flag(circ_cont, LV_OBJ_FLAG_SCROLLABLE);
 
+    build_mip_levels();
+    shown_level = 0;
+    shown_zoom = LV_IMG_ZOOM_NONE;
+
     circle_img = lv_img_create(circ_cont);
-    lv_img_set_src(circle_img, &circle_bg_png);
+    lv_img_set_src(circle_img, &mip_dsc[0]);
     lv_obj_center(circle_img);
     // Pivot giữa ảnh
     lv_img_set_pivot(circle_img, circle_bg_png.header.w / 2, circle_bg_png.header.h / 2);
+    lv_img_set_antialias(circle_img, CIRC_ANTIALIAS);
 
     back_btn = lv_btn_create(circ_cont);
     lv_obj_set_size(back_btn, 60, 40);
@@ -82,23 +202,18 @@ mv_page_err_code Circular_sub_page_deinit(void) {
     circ_cont = NULL;
     circle_img = NULL; 
     back_btn = NULL;
+    free_mip_levels();
     return MV_PAGE_RET_OK;
 }
 
 // --- UPDATE (CÓ CHỨC NĂNG CHECK LỖI) ---
 // --- UPDATE (ĐÃ CHỈNH LẠI THEO LOG THỰC TẾ) ---
 mv_page_err_code Circular_sub_page_main_function(mv_value_t *value) {
-    if (!circle_img || !value || !value->value) return MV_PAGE_RET_FAIL;
+    if (!circle_img || !value || !value->frame) return MV_PAGE_RET_FAIL;
 
-    // 1. Tính toán Bass
-    float bass_energy = 0.0f;
+    // 1. Tính toán Bass (prefix sum tính sẵn trên DSP thread)
     int samples = 30; 
-    for(int i = 0; i < samples; i++) {
-        float val = value->value[i];
-        if (val < 0) val = -val;
-        bass_energy += val;
-    }
-    bass_energy /= samples;
+    float bass_energy = mp_frame_bin_sum(value->frame, 0, samples) / samples;
 
     // --- [SỬA Ở ĐÂY] ---
     // Log của bạn: 17 ~ 80.
@@ -129,8 +244,24 @@ mv_page_err_code Circular_sub_page_main_function(mv_value_t *value) {
         current_scale = current_scale * 0.85f + target_scale * 0.15f;
     }
 
-    // Apply Zoom
-    lv_img_set_zoom(circle_img, (int)(current_scale * 256));
+    // Apply Zoom: mức mip gần nhất + zoom phần dư
+    int level = (int)((current_scale - 1.0f) / CIRC_MIP_STEP + 0.5f);
+    if (level < 0) level = 0;
+    if (level > mip_count - 1) level = mip_count - 1;
+
+    float residual = current_scale / (1.0f + level * CIRC_MIP_STEP);
+    int zoom = (int)(residual * LV_IMG_ZOOM_NONE);
+    if (fabsf(residual - 1.0f) < CIRC_ZOOM_SNAP) zoom = LV_IMG_ZOOM_NONE;
+
+    if (level != shown_level) {
+        lv_img_set_src(circle_img, &mip_dsc[level]);
+        lv_img_set_pivot(circle_img, mip_dsc[level].header.w / 2, mip_dsc[level].header.h / 2);
+        shown_level = level;
+    }
+    if (zoom != shown_zoom) {
+        lv_img_set_zoom(circle_img, zoom);
+        shown_zoom = zoom;
+    }
 
     return MV_PAGE_RET_OK;
 }
@@ -0,0 +1,19 @@
+#include "mv_rng.h"
+
+void mv_rng_seed(mv_rng_t *rng, uint64_t seed, uint64_t stream) {
+    rng->state = 0u;
+    rng->inc = (stream << 1u) | 1u;
+    mv_rng_next(rng);
+    rng->state += seed;
+    mv_rng_next(rng);
+}
+
+void mv_rng_fill_range(mv_rng_t *rng, float *dst, int count, float min, float max) {
+    // Trạng thái giữ trong biến cục bộ suốt vòng lặp thay vì ghi lại bộ nhớ mỗi số
+    mv_rng_t local = *rng;
+    const float span = (max - min) * (1.0f / 16777216.0f);
+    for (int i = 0; i < count; i++) {
+        dst[i] = min + (float)(mv_rng_next(&local) >> 8) * span;
+    }
+    *rng = local;
+}
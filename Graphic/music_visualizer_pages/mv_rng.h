@@ -0,0 +1,45 @@
+#ifndef MV_RNG_H
+#define MV_RNG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// PCG32 (O'Neill): bộ sinh số ngẫu nhiên riêng cho từng page.
+// Không khóa, không chia sẻ trạng thái với rand() của các thread khác,
+// và cùng seed -> cùng chuỗi số (replay hiệu ứng để benchmark).
+typedef struct mv_rng_t {
+    uint64_t state;
+    uint64_t inc;      // luôn lẻ, chọn "stream"
+} mv_rng_t;
+
+void mv_rng_seed(mv_rng_t *rng, uint64_t seed, uint64_t stream);
+
+static inline uint32_t mv_rng_next(mv_rng_t *rng) {
+    uint64_t old = rng->state;
+    rng->state = old * 6364136223846793005ULL + rng->inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = (uint32_t)(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31u));
+}
+
+// [0, 1), 24 bit
+static inline float mv_rng_float(mv_rng_t *rng) {
+    return (float)(mv_rng_next(rng) >> 8) * (1.0f / 16777216.0f);
+}
+
+// [min, max)
+static inline float mv_rng_range(mv_rng_t *rng, float min, float max) {
+    return min + (max - min) * mv_rng_float(rng);
+}
+
+// dst[0..count) = số ngẫu nhiên trong [min, max)
+void mv_rng_fill_range(mv_rng_t *rng, float *dst, int count, float min, float max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -34,3 +34,10 @@ mv_page_err_code SetSubpage(uint16_t index) {
     if (!MusicVisualizerPage) return MV_PAGE_RET_FAIL;
     return MV_PAGE_RET_OK;
 }
+
+int mv_value_copy(const mv_value_t *value, float *dst, int max_len) {
+    if (!value || !value->value || !dst || max_len <= 0) return 0;
+    int n = value->length < max_len ? value->length : max_len;
+    memcpy(dst, value->value, (size_t)n * sizeof(float));
+    return n;
+}
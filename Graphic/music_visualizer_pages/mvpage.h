@@ -2,6 +2,7 @@
 #define MUSIC_VISUALIZER_PAGE_H
 
 #include "../lvgl/lvgl.h"
+#include "../../MusicProcessor/musicprocessor.h"
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -24,8 +25,14 @@ typedef enum
     MV_PAGE_IDLE
 } mv_page_state_t;
 
+// Per-frame input of a visualizer page. The data belongs to the audio pipeline
+// and is shared with other consumers (LED thread): read it, never write it.
+// Copy with mv_value_copy() to rescale locally.
 typedef struct mv_value_t{
-    float* value;
+    const float* value;        // magnitude spectrum snapshot
+    int length;                // number of values in `value`
+    const mp_frame_t* frame;   // pinned frame: precomputed features, O(1) bin sums
+    uint64_t capture_ns;       // CLOCK_MONOTONIC capture time of the frame's newest sample
 } mv_value_t;
 
 typedef struct mv_page_t{
@@ -46,10 +53,18 @@ extern mv_page_t *list_subpages[MAX_SUBPAGES];  // <--- chỉ khai báo ở đâ
 
 mv_page_err_code SetSubpage(uint16_t index);
 
+// Copy up to max_len values of the snapshot into a page-owned buffer.
+// Returns the number of values copied.
+int mv_value_copy(const mv_value_t *value, float *dst, int max_len);
+
 /* Setup for Basic Music Visualizer */
 typedef struct basic_musicvisual_mv_page_t{
     mv_page_t base;
-    lv_obj_t *music_bar[BAR_NUMBER];
+    lv_obj_t *bars_canvas;              // all BAR_NUMBER bars rasterized into one buffer
+    lv_color_t *bars_cbuf;
+    lv_color_t bar_color[BAR_NUMBER];
+    int16_t bar_top[BAR_NUMBER];        // rows [bar_top, bar_bottom) currently painted
+    int16_t bar_bottom[BAR_NUMBER];
 } basic_musicvisual_mv_page_t;
 
 extern basic_musicvisual_mv_page_t BasicMusicVisualizerPage;
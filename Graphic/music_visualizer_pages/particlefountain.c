@@ -4,6 +4,8 @@
 // ==========================================
 #include "../music_visualizer_pages/mvpage.h" 
 #include "particlefountain.h"
+#include "canvas_util.h"
+#include "mv_rng.h"
 #include <lvgl/lvgl.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -14,35 +16,46 @@ extern mv_page_t ParticleFountainPage;
 LV_IMG_DECLARE(back_icon_png);
 
 // --- CẤU HÌNH ---
-#define PARTICLE_COUNT 200
+#define PARTICLE_COUNT 4096
+#define SPAWN_MAX 15        // Số hạt tối đa phun mỗi frame
+#define PARTICLE_RNG_SEED 0x9E3779B97F4A7C15ULL  // Cố định: cùng nhạc -> cùng hiệu ứng
 #define GRAVITY 0.7f        // Trọng lực mạnh hơn để rơi dứt khoát
 #define FRICTION 0.9f 
 #define BOUNCE_FACTOR 0.6f 
+#define PART_BG_COLOR lv_color_hex(0x101010)
 
 static int canvas_w = GRAPHIC_HOR_RES;
 static int canvas_h = GRAPHIC_VER_RES; 
 
+// Structure-of-arrays: hạt còn sống luôn nằm liền nhau trong [0, alive_count).
+// Spawn = thêm vào cuối, hạt chết được thay bằng hạt cuối -> cả hai O(1),
+// và vòng tích phân chỉ chạy trên các mảng liên tục (compiler vector hóa được).
 typedef struct {
-    float x, y;
-    float vx, vy;
-    int life;
-    int max_life;
-    lv_color_t color;
-    int size;
-} Particle;
+    float x[PARTICLE_COUNT];
+    float y[PARTICLE_COUNT];
+    float vx[PARTICLE_COUNT];
+    float vy[PARTICLE_COUNT];
+    int16_t life[PARTICLE_COUNT];
+    int16_t max_life[PARTICLE_COUNT];
+    uint8_t size[PARTICLE_COUNT];
+    int alive_count;
+} ParticlePool;
 
 static lv_obj_t *part_cont = NULL;
 static lv_obj_t *canvas = NULL;
 static lv_obj_t *back_btn = NULL;
 static lv_color_t *cbuf = NULL;
-static Particle particles[PARTICLE_COUNT]; 
+static ParticlePool pool;
+
+// Các ô đã vẽ ở frame trước: chỉ xóa đúng các ô này thay vì cả canvas
+static lv_area_t drawn_rects[PARTICLE_COUNT];
+static lv_color_t drawn_colors[PARTICLE_COUNT];
+static int drawn_count = 0;
 
 // BIẾN LƯU MỨC NĂNG LƯỢNG TRUNG BÌNH (ĐỂ SO SÁNH)
 static float average_energy = 0.0f; 
 
-static float random_float(float min, float max) {
-    return min + (float)rand() / ((float)RAND_MAX / (max - min));
-}
+static mv_rng_t rng;
 
 static lv_color_t get_fire_color(float life_percent) {
     if (life_percent > 0.8f) return lv_color_hex(0xFFFFFF); 
@@ -78,9 +91,11 @@ mv_page_err_code Particle_sub_page_init(lv_obj_t *parent) {
     if (!cbuf) return MV_PAGE_RET_FAIL;
     
     lv_canvas_set_buffer(canvas, cbuf, canvas_w, canvas_h, LV_IMG_CF_TRUE_COLOR);
-    lv_canvas_fill_bg(canvas, lv_color_hex(0x101010), LV_OPA_COVER);
+    lv_canvas_fill_bg(canvas, PART_BG_COLOR, LV_OPA_COVER);
 
-    for(int i=0; i<PARTICLE_COUNT; i++) particles[i].life = 0;
+    pool.alive_count = 0;
+    drawn_count = 0;
+    mv_rng_seed(&rng, PARTICLE_RNG_SEED, 1);
     
     // Reset mức trung bình
     average_energy = 0.0f;
@@ -105,42 +120,77 @@ mv_page_err_code Particle_sub_page_deinit(void) {
     return MV_PAGE_RET_OK;
 }
 
-static void spawn_particle(float power) {
-    for(int i=0; i<PARTICLE_COUNT; i++) {
-        if (particles[i].life <= 0) {
-            particles[i].x = canvas_w / 2;
-            particles[i].y = canvas_h - 5; 
-
-            // Spread (Tản ra 2 bên)
-            float spread = 15.0f; 
-            particles[i].vx = random_float(-spread, spread);
+// Phun `count` hạt một lượt: các hạt mới nằm liền nhau ở cuối pool,
+// nên số ngẫu nhiên được sinh theo lô thẳng vào các mảng
+static void spawn_particles(int count, float power) {
+    int first = pool.alive_count;
+    if (count > PARTICLE_COUNT - first) count = PARTICLE_COUNT - first;
+    if (count <= 0) return;
+
+    float life[SPAWN_MAX], size[SPAWN_MAX];
+
+    // Spread (Tản ra 2 bên)
+    float spread = 15.0f; 
+    mv_rng_fill_range(&rng, &pool.vx[first], count, -spread, spread);
+
+    // Power (Bay cao)
+    float launch_power = 12.0f + (power * 0.3f); 
+    mv_rng_fill_range(&rng, &pool.vy[first], count, -launch_power, -launch_power * 0.5f);
+
+    mv_rng_fill_range(&rng, life, count, 30, 60);
+    mv_rng_fill_range(&rng, size, count, 3, 6);
+
+    for (int k = 0; k < count; k++) {
+        int i = first + k;
+        pool.x[i] = canvas_w / 2;
+        pool.y[i] = canvas_h - 5; 
+        pool.life[i] = (int16_t)life[k];
+        pool.max_life[i] = pool.life[i];
+        pool.size[i] = (uint8_t)size[k];
+    }
+    pool.alive_count = first + count;
+}
 
-            // Power (Bay cao)
-            float launch_power = 12.0f + (power * 0.3f); 
-            particles[i].vy = -random_float(launch_power * 0.5f, launch_power);
+static void kill_particle(int i) {
+    int last = --pool.alive_count;
+    pool.x[i] = pool.x[last];
+    pool.y[i] = pool.y[last];
+    pool.vx[i] = pool.vx[last];
+    pool.vy[i] = pool.vy[last];
+    pool.life[i] = pool.life[last];
+    pool.max_life[i] = pool.max_life[last];
+    pool.size[i] = pool.size[last];
+}
 
-            particles[i].life = (int)random_float(30, 60);
-            particles[i].max_life = particles[i].life;
-            particles[i].size = (int)random_float(3, 6);
-            return; 
-        }
+// Tích phân vị trí/vận tốc: không rẽ nhánh, chạy trên mảng liên tục
+static void integrate_particles(int n) {
+    float *restrict x = pool.x;
+    float *restrict y = pool.y;
+    const float *restrict vx = pool.vx;
+    float *restrict vy = pool.vy;
+    for (int i = 0; i < n; i++) {
+        x[i] += vx[i];
+        y[i] += vy[i];
+        vy[i] += GRAVITY;
     }
 }
 
 mv_page_err_code Particle_sub_page_main_function(mv_value_t *value) {
-    if (!canvas || !value || !value->value) return MV_PAGE_RET_FAIL;
-
-    lv_canvas_fill_bg(canvas, lv_color_hex(0x101010), LV_OPA_COVER);
+    if (!canvas || !value || !value->frame) return MV_PAGE_RET_FAIL;
+
+    // Xóa các hạt của frame trước (vùng của chúng cũng phải vẽ lại)
+    canvas_dirty_t dirty;
+    canvas_dirty_reset(&dirty);
+    canvas_fill_rects(cbuf, canvas_w, canvas_h, drawn_rects, NULL, drawn_count, PART_BG_COLOR);
+    for (int i = 0; i < drawn_count; i++) {
+        lv_area_t *r = &drawn_rects[i];
+        canvas_dirty_add(&dirty, r->x1, r->y1, r->x2, r->y2);
+    }
+    drawn_count = 0;
 
     // 1. Tính Bass Hiện Tại (Instant Energy)
-    float instant_energy = 0;
     int samples = 15;
-    for(int i=0; i<samples; i++) {
-        float val = value->value[i];
-        if (val < 0) val = -val;
-        instant_energy += val;
-    }
-    instant_energy /= samples;
+    float instant_energy = mp_frame_bin_sum(value->frame, 0, samples) / samples;
 
     // 2. THUẬT TOÁN BEAT DETECTION (QUAN TRỌNG)
     // Tính mức độ đột biến: (Năng lượng hiện tại) - (Trung bình * Hệ số)
@@ -162,11 +212,9 @@ mv_page_err_code Particle_sub_page_main_function(mv_value_t *value) {
         // diff thường khoảng 10-40. 
         int spawn_count = (int)(diff / 4.0f);
         
-        if (spawn_count > 15) spawn_count = 15; // Max 1 lúc
+        if (spawn_count > SPAWN_MAX) spawn_count = SPAWN_MAX; // Max 1 lúc
         
-        for(int k=0; k<spawn_count; k++) {
-            spawn_particle(diff); // Truyền độ chênh lệch vào để tính độ cao
-        }
+        spawn_particles(spawn_count, diff); // Truyền độ chênh lệch vào để tính độ cao
     }
 
     // 3. Cập nhật mức trung bình (Moving Average)
@@ -175,40 +223,53 @@ mv_page_err_code Particle_sub_page_main_function(mv_value_t *value) {
     average_energy = average_energy * 0.9f + instant_energy * 0.1f;
 
 
-    // 4. Cập nhật & Vẽ
-    lv_draw_rect_dsc_t rect_dsc;
-    lv_draw_rect_dsc_init(&rect_dsc);
-
-    for(int i=0; i<PARTICLE_COUNT; i++) {
-        if (particles[i].life > 0) {
-            particles[i].x += particles[i].vx;
-            particles[i].y += particles[i].vy;
-            particles[i].vy += GRAVITY; 
-
-            // Nảy
-            if (particles[i].y >= canvas_h - 2) {
-                particles[i].y = canvas_h - 2; 
-                particles[i].vy = -particles[i].vy * BOUNCE_FACTOR;
-                particles[i].vx *= FRICTION;
-                if (fabs(particles[i].vy) < 1.0f) particles[i].vy = 0;
-            }
-            // Tường
-            if (particles[i].x <= 0 || particles[i].x >= canvas_w) {
-                particles[i].vx = -particles[i].vx * 0.8f; 
-                if (particles[i].x <= 0) particles[i].x = 1;
-                if (particles[i].x >= canvas_w) particles[i].x = canvas_w - 1;
-            }
-
-            particles[i].life--;
-
-            float life_pct = (float)particles[i].life / (float)particles[i].max_life;
-            rect_dsc.bg_color = get_fire_color(life_pct);
-
-            lv_canvas_draw_rect(canvas, (int)particles[i].x, (int)particles[i].y, 
-                              particles[i].size, particles[i].size, &rect_dsc);
+    // 4. Cập nhật
+    int n = pool.alive_count;
+    integrate_particles(n);
+
+    for (int i = 0; i < n; i++) {
+        // Nảy
+        if (pool.y[i] >= canvas_h - 2) {
+            pool.y[i] = canvas_h - 2; 
+            pool.vy[i] = -pool.vy[i] * BOUNCE_FACTOR;
+            pool.vx[i] *= FRICTION;
+            if (fabsf(pool.vy[i]) < 1.0f) pool.vy[i] = 0;
         }
+        // Tường
+        if (pool.x[i] <= 0 || pool.x[i] >= canvas_w) {
+            pool.vx[i] = -pool.vx[i] * 0.8f; 
+            if (pool.x[i] <= 0) pool.x[i] = 1;
+            if (pool.x[i] >= canvas_w) pool.x[i] = canvas_w - 1;
+        }
+        pool.life[i]--;
     }
 
+    // 5. Vẽ: gom tất cả ô rồi tô một lượt (ghi thẳng vào cbuf, chỉ invalidate vùng thay đổi)
+    for (int i = 0; i < n; i++) {
+        float life_pct = (float)pool.life[i] / (float)pool.max_life[i];
+
+        int x = (int)pool.x[i];
+        int y = (int)pool.y[i];
+        int size = pool.size[i];
+
+        lv_area_t *r = &drawn_rects[drawn_count];
+        r->x1 = x;
+        r->y1 = y;
+        r->x2 = x + size - 1;
+        r->y2 = y + size - 1;
+        drawn_colors[drawn_count++] = get_fire_color(life_pct);
+        canvas_dirty_add(&dirty, r->x1, r->y1, r->x2, r->y2);
+    }
+    canvas_fill_rects(cbuf, canvas_w, canvas_h, drawn_rects, drawn_colors, drawn_count, PART_BG_COLOR);
+
+    // Hạt hết đời (đã vẽ lần cuối ở trên) rời khỏi vùng sống
+    for (int i = 0; i < pool.alive_count; ) {
+        if (pool.life[i] <= 0) kill_particle(i);
+        else i++;
+    }
+
+    canvas_dirty_invalidate(canvas, &dirty);
+
     return MV_PAGE_RET_OK;
 }
 
@@ -4,6 +4,7 @@
 // ==========================================
 #include "../music_visualizer_pages/mvpage.h" 
 #include "peakmeter.h"
+#include "canvas_util.h"
 #include <lvgl/lvgl.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -19,6 +20,7 @@ LV_IMG_DECLARE(back_icon_png);
 #define SEGMENT_GAP 2      // Khe hở giữa các viên LED
 #define PEAK_GRAVITY 2.0f  
 #define PEAK_HOLD_TIME 15  
+#define PEAK_BG_COLOR lv_color_hex(0x000000)
 
 static int canvas_w = GRAPHIC_HOR_RES;
 static int canvas_h = GRAPHIC_VER_RES; 
@@ -32,6 +34,69 @@ static float bar_heights[BAR_COUNT];
 static float peak_levels[BAR_COUNT];
 static int peak_hold_timers[BAR_COUNT];
 
+// Trạng thái đã vẽ của từng cột: chỉ vẽ phần chênh lệch giữa hai frame
+static int drawn_lit[BAR_COUNT];      // số hàng LED đang sáng tính từ center_y
+static int drawn_peak[BAR_COUNT];     // -1: chưa vẽ peak
+
+// Sprite cột LED dựng sẵn: màu của hàng cách center_y d pixel
+// (màu segment hoặc màu nền ở khe hở). Nửa trên sáng, nửa dưới phản chiếu tối hơn.
+#define SPRITE_ROWS (GRAPHIC_VER_RES / 2)
+static lv_color_t led_sprite_top[SPRITE_ROWS];
+static lv_color_t led_sprite_bottom[SPRITE_ROWS];
+
+static void build_led_sprite(int max_h) {
+    int step = SEGMENT_HEIGHT + SEGMENT_GAP;
+    for (int y = 0; y < SPRITE_ROWS; y += step) {
+        // Dưới thấp: Xanh (Hue 120) -> Giữa: Vàng (Hue 60) -> Cao: Đỏ (Hue 0)
+        float percent = (float)y / (float)max_h;
+        int hue = (int)(120.0f * (1.0f - percent));
+        if (hue < 0) hue = 0;
+
+        lv_color_t top = lv_color_hsv_to_rgb(hue, 100, 100);
+        lv_color_t bottom = lv_color_hsv_to_rgb(hue, 100, 70); // Phản chiếu: Val 70%
+        for (int d = y; d < y + step && d < SPRITE_ROWS; d++) {
+            int gap = d >= y + SEGMENT_HEIGHT;
+            led_sprite_top[d] = gap ? PEAK_BG_COLOR : top;
+            led_sprite_bottom[d] = gap ? PEAK_BG_COLOR : bottom;
+        }
+    }
+}
+
+// Ghi lại các hàng [d1, d2) của một cột (cả hai nửa) theo trạng thái mới:
+// vạch peak, hoặc sprite nếu nằm trong phần sáng, hoặc nền.
+static void column_write_rows(canvas_dirty_t *dirty, int x, int bar_w, int center_y,
+                              int d1, int d2, int lit, int peak_y) {
+    int x2 = LV_MIN(x + bar_w, canvas_w);
+    if (d1 < 0) d1 = 0;
+    if (d2 > center_y) d2 = center_y;
+    if (d2 > canvas_h - center_y) d2 = canvas_h - center_y;
+    if (d1 >= d2 || x >= x2) return;
+
+    lv_color_t peak_color = lv_color_hex(0xFFFFFF); // Peak màu trắng
+
+    for (int d = d1; d < d2; d++) {
+        lv_color_t top, bottom;
+        if (peak_y >= 0 && d >= peak_y && d < peak_y + 2) {
+            top = bottom = peak_color;
+        } else if (d < lit && d < SPRITE_ROWS) {
+            top = led_sprite_top[d];
+            bottom = led_sprite_bottom[d];
+        } else {
+            top = bottom = PEAK_BG_COLOR;
+        }
+
+        lv_color_t *row_top = cbuf + (center_y - 1 - d) * canvas_w;
+        lv_color_t *row_bottom = cbuf + (center_y + d) * canvas_w;
+        for (int col = x; col < x2; col++) {
+            row_top[col] = top;
+            row_bottom[col] = bottom;
+        }
+    }
+
+    canvas_dirty_add(dirty, x, center_y - d2, x2 - 1, center_y - 1 - d1);
+    canvas_dirty_add(dirty, x, center_y + d1, x2 - 1, center_y + d2 - 1);
+}
+
 static void back_event_handler(lv_event_t *e) {
     (void)e;
     extern mv_page_t *MusicVisualizerPage; 
@@ -59,12 +124,15 @@ mv_page_err_code PeakMeter_sub_page_init(lv_obj_t *parent) {
     if (!cbuf) return MV_PAGE_RET_FAIL;
     
     lv_canvas_set_buffer(canvas, cbuf, canvas_w, canvas_h, LV_IMG_CF_TRUE_COLOR);
-    lv_canvas_fill_bg(canvas, lv_color_hex(0x000000), LV_OPA_COVER);
+    lv_canvas_fill_bg(canvas, PEAK_BG_COLOR, LV_OPA_COVER);
+    build_led_sprite((canvas_h / 2) - 20);
 
     for(int i=0; i<BAR_COUNT; i++) {
         bar_heights[i] = 0.0f;
         peak_levels[i] = 0.0f;
         peak_hold_timers[i] = 0;
+        drawn_lit[i] = 0;
+        drawn_peak[i] = -1;
     }
 
     back_btn = lv_btn_create(peak_cont);
@@ -91,14 +159,9 @@ mv_page_err_code PeakMeter_sub_page_deinit(void) {
 mv_page_err_code PeakMeter_sub_page_main_function(mv_value_t *value) {
     if (!canvas || !value || !value->value) return MV_PAGE_RET_FAIL;
 
-    lv_canvas_fill_bg(canvas, lv_color_hex(0x000000), LV_OPA_COVER);
-
-    lv_draw_rect_dsc_t led_dsc;
-    lv_draw_rect_dsc_init(&led_dsc);
-    
-    lv_draw_rect_dsc_t peak_dsc;
-    lv_draw_rect_dsc_init(&peak_dsc);
-    peak_dsc.bg_color = lv_color_hex(0xFFFFFF); // Peak màu trắng
+    // Chỉ phần chênh lệch của các cột được ghi lại (thẳng vào cbuf)
+    canvas_dirty_t dirty;
+    canvas_dirty_reset(&dirty);
 
     int center_y = canvas_h / 2;
     float bar_width_float = (float)canvas_w / (float)BAR_COUNT;
@@ -109,7 +172,7 @@ mv_page_err_code PeakMeter_sub_page_main_function(mv_value_t *value) {
 
     for (int i = 0; i < BAR_COUNT; i++) {
         int input_idx = i * (BAR_NUMBER / BAR_COUNT); 
-        float raw_val = value->value[input_idx];
+        float raw_val = (input_idx < value->length) ? value->value[input_idx] : 0.0f;
         if (raw_val < 0) raw_val = -raw_val;
 
         // Smoothing (Nhanh hơn chút cho LED nảy)
@@ -138,47 +201,44 @@ mv_page_err_code PeakMeter_sub_page_main_function(mv_value_t *value) {
 
         int x = (int)(i * bar_width_float) + 3;
 
-        // --- VẼ CÁC VIÊN LED (SEGMENTS) ---
-        // Thay vì vẽ 1 thanh dài, ta vẽ vòng lặp các viên nhỏ
-        for (int y = 0; y < h; y += (SEGMENT_HEIGHT + SEGMENT_GAP)) {
-            
-            // Tính toán màu sắc dựa trên độ cao (Zone Color)
-            // Dưới thấp: Xanh (Hue 120) -> Giữa: Vàng (Hue 60) -> Cao: Đỏ (Hue 0)
-            float percent = (float)y / (float)max_h; // 0.0 -> 1.0
-            
-            // Xanh (120) -> Đỏ (0)
-            int hue = (int)(120.0f * (1.0f - percent)); 
-            if (hue < 0) hue = 0;
-            
-            led_dsc.bg_color = lv_color_hsv_to_rgb(hue, 100, 100);
-
-            // Vẽ viên LED trên
-            lv_canvas_draw_rect(canvas, x, center_y - y - SEGMENT_HEIGHT, bar_w, SEGMENT_HEIGHT, &led_dsc);
-            
-            // Vẽ viên LED dưới (Đối xứng)
-            // Giảm độ sáng cho phần phản chiếu dưới nước (cho nghệ)
-            lv_color_t mirror_col = lv_color_hsv_to_rgb(hue, 100, 70); // Val 70%
-            led_dsc.bg_color = mirror_col;
-            lv_canvas_draw_rect(canvas, x, center_y + y, bar_w, SEGMENT_HEIGHT, &led_dsc);
-        }
-
-        // --- VẼ PEAK (VẠCH ĐỈNH) ---
-        // Vẽ Peak dưới dạng một viên LED mỏng màu trắng
+        int step = SEGMENT_HEIGHT + SEGMENT_GAP;
+        int peak_y = -1;   // -1: không có peak
         if (peak_levels[i] > 0) {
-            int peak_y = (int)peak_levels[i];
-            
             // Snap to grid: Làm tròn vị trí Peak vào đúng ô lưới LED
             // Để Peak không bị lơ lửng giữa các khe hở
-            int step = SEGMENT_HEIGHT + SEGMENT_GAP;
-            peak_y = (peak_y / step) * step; 
+            peak_y = ((int)peak_levels[i] / step) * step;
+        }
+
+        // Các viên LED (SEGMENTS) sáng: mọi segment bắt đầu dưới h, tức
+        // các hàng [0, lit) của sprite
+        int lit = ((h + step - 1) / step) * step;
 
-            // Peak Trên
-            lv_canvas_draw_rect(canvas, x, center_y - peak_y - 2, bar_w, 2, &peak_dsc);
-            // Peak Dưới
-            lv_canvas_draw_rect(canvas, x, center_y + peak_y, bar_w, 2, &peak_dsc);
+        int old_lit = drawn_lit[i];
+        int old_peak = drawn_peak[i];
+        if (lit == old_lit && peak_y == old_peak) continue;
+
+        // Phần cột dài ra / ngắn lại
+        if (lit != old_lit) {
+            column_write_rows(&dirty, x, bar_w, center_y,
+                              LV_MIN(lit, old_lit), LV_MAX(lit, old_lit), lit, peak_y);
+        }
+        // --- PEAK (VẠCH ĐỈNH) ---
+        // Trả lại hàng của vạch cũ rồi vẽ vạch mới
+        if (peak_y != old_peak) {
+            if (old_peak >= 0) {
+                column_write_rows(&dirty, x, bar_w, center_y, old_peak, old_peak + 2, lit, peak_y);
+            }
+            if (peak_y >= 0) {
+                column_write_rows(&dirty, x, bar_w, center_y, peak_y, peak_y + 2, lit, peak_y);
+            }
         }
+
+        drawn_lit[i] = lit;
+        drawn_peak[i] = peak_y;
     }
 
+    canvas_dirty_invalidate(canvas, &dirty);
+
     return MV_PAGE_RET_OK;
 }
 
@@ -4,10 +4,12 @@
 // ==========================================
 #include "../music_visualizer_pages/mvpage.h" 
 #include "pinkdiamond.h"
+#include "mv_rng.h"
 #include <lvgl/lvgl.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 #include <graphic.h>
 
 extern mv_page_t PinkDiamondPage;
@@ -16,7 +18,7 @@ LV_IMG_DECLARE(back_icon_png);
 LV_IMG_DECLARE(pink_diamond_png); 
 
 // --- CẤU HÌNH ---
-#define DIAMOND_COUNT 12     // Giảm nhẹ số lượng để va chạm đỡ bị kẹt
+#define DIAMOND_COUNT 48     // Broadphase lưới: chi phí va chạm ~O(n), vài trăm viên vẫn chạy được
 #define FOV 400.0f           
 #define BOUNDS_X 1600        // Không gian rộng
 #define BOUNDS_Y 900        
@@ -26,6 +28,16 @@ LV_IMG_DECLARE(pink_diamond_png);
 // Bán kính va chạm (giả sử trong không gian 3D, kim cương to khoảng 150 đơn vị)
 #define COLLISION_RADIUS 180.0f 
 
+#define DIAMOND_RNG_SEED 0xD1A3D0C5ULL
+
+// Lưới đều cho broadphase: ô cạnh = đường kính va chạm, nên hai viên chạm nhau
+// luôn nằm trong cùng ô hoặc hai ô kề nhau
+#define GRID_CELL ((int)COLLISION_RADIUS * 2)
+#define GRID_NX (2 * BOUNDS_X / GRID_CELL + 1)
+#define GRID_NY (2 * BOUNDS_Y / GRID_CELL + 1)
+#define GRID_NZ (((int)Z_MAX - (int)Z_MIN) / GRID_CELL + 1)
+#define GRID_CELLS (GRID_NX * GRID_NY * GRID_NZ)
+
 static int screen_w = GRAPHIC_HOR_RES;
 static int screen_h = GRAPHIC_VER_RES; 
 
@@ -34,15 +46,27 @@ typedef struct {
     float x, y, z;     
     float vx, vy, vz;  
     // Đã bỏ các biến rotation
+
+    // Giá trị đã đưa cho LVGL: chỉ gọi setter khi thay đổi
+    int shown_x, shown_y;
+    int shown_zoom;
+    int shown_opa;
 } Diamond3D;
 
 static lv_obj_t *cont = NULL;
 static lv_obj_t *back_btn = NULL;
 static Diamond3D diamonds[DIAMOND_COUNT];
 
-static float random_float(float min, float max) {
-    return min + (float)rand() / ((float)RAND_MAX / (max - min));
-}
+// Broadphase: diamond theo ô (counting sort mỗi frame, không cấp phát)
+static int cell_of[DIAMOND_COUNT];
+static int cell_start[GRID_CELLS + 1];
+static int cell_items[DIAMOND_COUNT];
+
+// Thứ tự vẽ: depth_order[k] = viên thứ k từ xa đến gần (children 0..n-1 của cont)
+static int depth_order[DIAMOND_COUNT];
+static int child_order[DIAMOND_COUNT];   // thứ tự LVGL đang giữ
+
+static mv_rng_t rng;
 
 static void back_event_handler(lv_event_t *e) {
     (void)e;
@@ -54,81 +78,160 @@ static void back_event_handler(lv_event_t *e) {
 }
 
 static void init_diamond(int i) {
-    diamonds[i].x = random_float(-BOUNDS_X, BOUNDS_X);
-    diamonds[i].y = random_float(-BOUNDS_Y, BOUNDS_Y);
-    diamonds[i].z = random_float(Z_MIN, Z_MAX);
+    // 6 số trong [-1, 1) một lượt, rồi co giãn theo từng trục
+    float r[6];
+    mv_rng_fill_range(&rng, r, 6, -1.0f, 1.0f);
+
+    diamonds[i].x = r[0] * BOUNDS_X;
+    diamonds[i].y = r[1] * BOUNDS_Y;
+    diamonds[i].z = Z_MIN + (r[2] + 1.0f) * 0.5f * (Z_MAX - Z_MIN);
 
     // Tốc độ bay vừa phải
-    diamonds[i].vx = random_float(-1.5f, 1.5f); 
-    diamonds[i].vy = random_float(-1.5f, 1.5f);
-    diamonds[i].vz = random_float(-0.5f, 0.5f); 
+    diamonds[i].vx = r[3] * 1.5f; 
+    diamonds[i].vy = r[4] * 1.5f;
+    diamonds[i].vz = r[5] * 0.5f; 
 
     diamonds[i].img_obj = lv_img_create(cont);
     lv_img_set_src(diamonds[i].img_obj, &pink_diamond_png);
     lv_img_set_pivot(diamonds[i].img_obj, pink_diamond_png.header.w / 2, pink_diamond_png.header.h / 2);
     
-    // [QUAN TRỌNG] Reset góc xoay về 0 (Thẳng đứng)
+    // [QUAN TRỌNG] Reset góc xoay về 0 (Thẳng đứng), không đổi nữa
     lv_img_set_angle(diamonds[i].img_obj, 0);
+
+    diamonds[i].shown_x = INT32_MIN;
+    diamonds[i].shown_y = INT32_MIN;
+    diamonds[i].shown_zoom = -1;
+    diamonds[i].shown_opa = -1;
+    depth_order[i] = i;
+    child_order[i] = i;
+}
+
+static int grid_coord(float v, float min, int n) {
+    int c = (int)((v - min) / (float)GRID_CELL);
+    if (c < 0) c = 0;
+    if (c >= n) c = n - 1;
+    return c;
+}
+
+static int grid_cell(const Diamond3D *d) {
+    int cx = grid_coord(d->x, -BOUNDS_X, GRID_NX);
+    int cy = grid_coord(d->y, -BOUNDS_Y, GRID_NY);
+    int cz = grid_coord(d->z, Z_MIN, GRID_NZ);
+    return (cz * GRID_NY + cy) * GRID_NX + cx;
+}
+
+// --- VA CHẠM GIỮA HAI VIÊN KIM CƯƠNG ---
+static void collide_pair(int i, int j) {
+    // Tính khoảng cách giữa 2 viên (dx, dy, dz)
+    float dx = diamonds[j].x - diamonds[i].x;
+    float dy = diamonds[j].y - diamonds[i].y;
+    float dz = diamonds[j].z - diamonds[i].z;
+    
+    // Khoảng cách bình phương (để đỡ phải căn bậc 2 nếu chưa cần)
+    float distSq = dx*dx + dy*dy + dz*dz;
+    
+    // Khoảng cách tối thiểu để không chạm nhau (Radius 1 + Radius 2)
+    float minDist = COLLISION_RADIUS * 2; 
+
+    // Nếu khoảng cách thực tế < khoảng cách tối thiểu -> Đang chạm nhau
+    if (distSq < minDist * minDist) {
+        float dist = sqrtf(distSq);
+        if (dist < 0.1f) dist = 0.1f; // Tránh chia cho 0
+
+        // 1. Phản hồi đàn hồi (Đổi hướng vận tốc)
+        // Đơn giản hóa: Trao đổi vận tốc cho nhau (Elastic Collision approximation)
+        // (Cách này tạo ra hiệu ứng nảy hỗn loạn rất vui mắt)
+        float temp_vx = diamonds[i].vx;
+        float temp_vy = diamonds[i].vy;
+        float temp_vz = diamonds[i].vz;
+
+        diamonds[i].vx = diamonds[j].vx;
+        diamonds[i].vy = diamonds[j].vy;
+        diamonds[i].vz = diamonds[j].vz;
+
+        diamonds[j].vx = temp_vx;
+        diamonds[j].vy = temp_vy;
+        diamonds[j].vz = temp_vz;
+
+        // 2. Chống dính (Overlap Correction)
+        // Đẩy 2 viên ra xa nhau một chút để không bị kẹt dính vào nhau
+        float overlap = minDist - dist;
+        float nx = dx / dist; // Vector hướng
+        float ny = dy / dist;
+        float nz = dz / dist;
+
+        // Đẩy mỗi viên ra một nửa khoảng chồng lấn
+        float push = overlap * 0.5f;
+        
+        diamonds[i].x -= nx * push;
+        diamonds[i].y -= ny * push;
+        diamonds[i].z -= nz * push;
+        
+        diamonds[j].x += nx * push;
+        diamonds[j].y += ny * push;
+        diamonds[j].z += nz * push;
+    }
 }
 
 // --- HÀM XỬ LÝ VA CHẠM GIỮA CÁC VIÊN KIM CƯƠNG ---
+// Broadphase lưới đều: mỗi viên chỉ thử các viên trong 27 ô lân cận
 static void resolve_collisions() {
+    // Counting sort các viên theo ô
+    memset(cell_start, 0, sizeof(cell_start));
+    for (int i = 0; i < DIAMOND_COUNT; i++) {
+        cell_of[i] = grid_cell(&diamonds[i]);
+        cell_start[cell_of[i] + 1]++;
+    }
+    for (int c = 0; c < GRID_CELLS; c++) cell_start[c + 1] += cell_start[c];
+    int fill[GRID_CELLS];
+    memcpy(fill, cell_start, sizeof(fill));
+    for (int i = 0; i < DIAMOND_COUNT; i++) cell_items[fill[cell_of[i]]++] = i;
+
     for (int i = 0; i < DIAMOND_COUNT; i++) {
-        for (int j = i + 1; j < DIAMOND_COUNT; j++) {
-            
-            // Tính khoảng cách giữa 2 viên (dx, dy, dz)
-            float dx = diamonds[j].x - diamonds[i].x;
-            float dy = diamonds[j].y - diamonds[i].y;
-            float dz = diamonds[j].z - diamonds[i].z;
-            
-            // Khoảng cách bình phương (để đỡ phải căn bậc 2 nếu chưa cần)
-            float distSq = dx*dx + dy*dy + dz*dz;
-            
-            // Khoảng cách tối thiểu để không chạm nhau (Radius 1 + Radius 2)
-            float minDist = COLLISION_RADIUS * 2; 
-
-            // Nếu khoảng cách thực tế < khoảng cách tối thiểu -> Đang chạm nhau
-            if (distSq < minDist * minDist) {
-                float dist = sqrtf(distSq);
-                if (dist < 0.1f) dist = 0.1f; // Tránh chia cho 0
-
-                // 1. Phản hồi đàn hồi (Đổi hướng vận tốc)
-                // Đơn giản hóa: Trao đổi vận tốc cho nhau (Elastic Collision approximation)
-                // (Cách này tạo ra hiệu ứng nảy hỗn loạn rất vui mắt)
-                float temp_vx = diamonds[i].vx;
-                float temp_vy = diamonds[i].vy;
-                float temp_vz = diamonds[i].vz;
-
-                diamonds[i].vx = diamonds[j].vx;
-                diamonds[i].vy = diamonds[j].vy;
-                diamonds[i].vz = diamonds[j].vz;
-
-                diamonds[j].vx = temp_vx;
-                diamonds[j].vy = temp_vy;
-                diamonds[j].vz = temp_vz;
-
-                // 2. Chống dính (Overlap Correction)
-                // Đẩy 2 viên ra xa nhau một chút để không bị kẹt dính vào nhau
-                float overlap = minDist - dist;
-                float nx = dx / dist; // Vector hướng
-                float ny = dy / dist;
-                float nz = dz / dist;
-
-                // Đẩy mỗi viên ra một nửa khoảng chồng lấn
-                float push = overlap * 0.5f;
-                
-                diamonds[i].x -= nx * push;
-                diamonds[i].y -= ny * push;
-                diamonds[i].z -= nz * push;
-                
-                diamonds[j].x += nx * push;
-                diamonds[j].y += ny * push;
-                diamonds[j].z += nz * push;
+        int c = cell_of[i];
+        int cx = c % GRID_NX;
+        int cy = (c / GRID_NX) % GRID_NY;
+        int cz = c / (GRID_NX * GRID_NY);
+
+        for (int z = LV_MAX(cz - 1, 0); z <= LV_MIN(cz + 1, GRID_NZ - 1); z++) {
+            for (int y = LV_MAX(cy - 1, 0); y <= LV_MIN(cy + 1, GRID_NY - 1); y++) {
+                for (int x = LV_MAX(cx - 1, 0); x <= LV_MIN(cx + 1, GRID_NX - 1); x++) {
+                    int n = (z * GRID_NY + y) * GRID_NX + x;
+                    for (int k = cell_start[n]; k < cell_start[n + 1]; k++) {
+                        int j = cell_items[k];
+                        if (j > i) collide_pair(i, j);   // mỗi cặp một lần
+                    }
+                }
             }
         }
     }
 }
 
+// Sắp xếp từ xa đến gần (insertion sort: thứ tự gần như giữ nguyên giữa các frame)
+// rồi chỉ dời các object LVGL thực sự đổi chỗ
+static void update_depth_order() {
+    for (int k = 1; k < DIAMOND_COUNT; k++) {
+        int idx = depth_order[k];
+        float z = diamonds[idx].z;
+        int m = k - 1;
+        while (m >= 0 && diamonds[depth_order[m]].z < z) {
+            depth_order[m + 1] = depth_order[m];
+            m--;
+        }
+        depth_order[m + 1] = idx;
+    }
+
+    for (int k = 0; k < DIAMOND_COUNT; k++) {
+        if (child_order[k] == depth_order[k]) continue;
+
+        int p = k + 1;
+        while (child_order[p] != depth_order[k]) p++;
+        memmove(&child_order[k + 1], &child_order[k], (size_t)(p - k) * sizeof(int));
+        child_order[k] = depth_order[k];
+        lv_obj_move_to_index(diamonds[depth_order[k]].img_obj, k);
+    }
+}
+
 mv_page_err_code PinkDiamond_sub_page_init(lv_obj_t *parent) {
     if (!parent) return MV_PAGE_RET_FAIL;
     PinkDiamondPage.state = MV_PAGE_INIT;
@@ -140,6 +243,7 @@ mv_page_err_code PinkDiamond_sub_page_init(lv_obj_t *parent) {
     lv_obj_set_style_bg_grad_dir(cont, LV_GRAD_DIR_VER, 0);
     lv_obj_clear_flag(cont, LV_OBJ_FLAG_SCROLLABLE);
 
+    mv_rng_seed(&rng, DIAMOND_RNG_SEED, 2);
     for(int i=0; i<DIAMOND_COUNT; i++) {
         init_diamond(i);
     }
@@ -164,12 +268,10 @@ mv_page_err_code PinkDiamond_sub_page_deinit(void) {
 
 // --- UPDATE ---
 mv_page_err_code PinkDiamond_sub_page_main_function(mv_value_t *value) {
-    if (!cont || !value || !value->value) return MV_PAGE_RET_FAIL;
+    if (!cont || !value || !value->frame) return MV_PAGE_RET_FAIL;
 
-    // Tính Bass
-    float bass_sum = 0;
-    for(int i=0; i<20; i++) bass_sum += fabsf(value->value[i]);
-    bass_sum /= 20.0f;
+    // Tính Bass (prefix sum tính sẵn trên DSP thread)
+    float bass_sum = mp_frame_bin_sum(value->frame, 0, 20) / 20.0f;
 
     float music_speed = 1.0f + (bass_sum * 0.015f); 
     float music_scale = 1.0f + (bass_sum * 0.01f);
@@ -193,33 +295,43 @@ mv_page_err_code PinkDiamond_sub_page_main_function(mv_value_t *value) {
 
         if (diamonds[i].z > Z_MAX) { diamonds[i].z = Z_MAX; diamonds[i].vz *= -1; }
         else if (diamonds[i].z < Z_MIN) { diamonds[i].z = Z_MIN; diamonds[i].vz *= -1; }
-        
-        // Luôn đảm bảo góc là 0 (Thẳng đứng)
-        lv_img_set_angle(diamonds[i].img_obj, 0);
     }
 
     // --- BƯỚC 2: XỬ LÝ VA CHẠM GIỮA CÁC VIÊN (MỚI) ---
     resolve_collisions();
+    update_depth_order();
 
     // --- BƯỚC 3: HIỂN THỊ LÊN MÀN HÌNH ---
     for(int i=0; i<DIAMOND_COUNT; i++) {
         float scale_factor = FOV / (FOV + diamonds[i].z);
         
-        int x_2d = center_x + (int)(diamonds[i].x * scale_factor);
-        int y_2d = center_y + (int)(diamonds[i].y * scale_factor);
-
-        lv_obj_set_pos(diamonds[i].img_obj, x_2d, y_2d);
+        Diamond3D *d = &diamonds[i];
+        int x_2d = center_x + (int)(d->x * scale_factor);
+        int y_2d = center_y + (int)(d->y * scale_factor);
+
+        if (x_2d != d->shown_x || y_2d != d->shown_y) {
+            lv_obj_set_pos(d->img_obj, x_2d, y_2d);
+            d->shown_x = x_2d;
+            d->shown_y = y_2d;
+        }
 
         int final_zoom = (int)(200.0f * scale_factor * music_scale);
         if (final_zoom < 10) final_zoom = 10;
         if (final_zoom > 2000) final_zoom = 2000;
 
-        lv_img_set_zoom(diamonds[i].img_obj, final_zoom);
+        if (final_zoom != d->shown_zoom) {
+            lv_img_set_zoom(d->img_obj, final_zoom);
+            d->shown_zoom = final_zoom;
+        }
         
         int opacity = (int)(255 * scale_factor);
         if (opacity > 255) opacity = 255;
         if (opacity < 60) opacity = 60;
-        lv_obj_set_style_img_opa(diamonds[i].img_obj, opacity, 0);
+        // Style setter làm LVGL tính lại style: chỉ gọi khi giá trị đổi
+        if (opacity != d->shown_opa) {
+            lv_obj_set_style_img_opa(d->img_obj, opacity, 0);
+            d->shown_opa = opacity;
+        }
     }
 
     return MV_PAGE_RET_OK;
@@ -1,12 +1,15 @@
 // ==========================================
 // FILE: waveform.c
 // STYLE: Oscilloscope (Classic Green Phosphor CRT Style)
+// DATA: mp_frame_t.scope (time-domain, trigger-aligned), phổ nếu không có
 // ==========================================
 #include "../music_visualizer_pages/mvpage.h" 
 
 #include "waveform.h"
+#include "canvas_util.h"
 #include <lvgl/lvgl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdio.h>
 #include <math.h>
 #include <graphic.h>
@@ -17,6 +20,10 @@ LV_IMG_DECLARE(back_icon_png);
 
 // --- CẤU HÌNH ---
 #define POINT_COUNT 64      
+#define TRACE_WIDTH 4       // Độ dày đường sóng (px)
+#define DIRTY_STRIPS 16     // Số dải dọc dùng để gom vùng dirty
+#define GRID_COLS 10
+#define GRID_ROWS 8
 static int canvas_w = GRAPHIC_HOR_RES;
 static int canvas_h = GRAPHIC_VER_RES; 
 
@@ -33,16 +40,28 @@ static lv_obj_t *wave_cont = NULL;
 static lv_obj_t *canvas = NULL;
 static lv_obj_t *back_btn = NULL;
 static lv_color_t *cbuf = NULL;
+static lv_color_t *bg_layer = NULL;   // Nền CRT + lưới dựng sẵn một lần lúc init
 
 static float prev_values[POINT_COUNT]; 
 static float smooth_data[POINT_COUNT];
 
+// Đường sóng đang hiển thị: mỗi cột x tô các hàng [span_top, span_bottom]
+// (span_top > span_bottom: cột chưa vẽ gì). Frame sau chỉ phục hồi nền
+// ở những hàng này thay vì xóa cả canvas.
+static int16_t trace_top[GRAPHIC_HOR_RES];      // đường sóng ở mỗi cột (trước khi làm dày nét)
+static int16_t trace_bottom[GRAPHIC_HOR_RES];
+static int16_t span_top[GRAPHIC_HOR_RES];
+static int16_t span_bottom[GRAPHIC_HOR_RES];
+
+static void draw_oscilloscope_grid();
+
 static void back_event_handler(lv_event_t *e)
 {
     (void)e;
     extern mv_page_t *MusicVisualizerPage; 
     MusicVisualizerPage = NULL;
     if (cbuf) { free(cbuf); cbuf = NULL; }
+    if (bg_layer) { free(bg_layer); bg_layer = NULL; }
     lv_obj_clean(lv_scr_act());
     extern void mainpage_create(lv_obj_t *parent);
     mainpage_create(lv_scr_act());
@@ -68,11 +87,21 @@ mv_page_err_code Waveform_sub_page_init(lv_obj_t *parent) {
     lv_canvas_set_buffer(canvas, cbuf, canvas_w, canvas_h, LV_IMG_CF_TRUE_COLOR);
     // [SỬA MÀU NỀN CANVAS]
     lv_canvas_fill_bg(canvas, CRT_BG_COLOR, LV_OPA_COVER);
+    draw_oscilloscope_grid();
+
+    // Giữ lại bản sao nền + lưới: mỗi frame chỉ chép lại các hàng đường sóng đã đi qua
+    bg_layer = (lv_color_t *)malloc(LV_CANVAS_BUF_SIZE_TRUE_COLOR(canvas_w, canvas_h));
+    if (bg_layer == NULL) return MV_PAGE_RET_FAIL;
+    memcpy(bg_layer, cbuf, LV_CANVAS_BUF_SIZE_TRUE_COLOR(canvas_w, canvas_h));
 
     for(int i=0; i<POINT_COUNT; i++) {
         prev_values[i] = 0.0f;
         smooth_data[i] = 0.0f;
     }
+    for (int x = 0; x < canvas_w; x++) {
+        span_top[x] = 1;
+        span_bottom[x] = 0;
+    }
 
     back_btn = lv_btn_create(wave_cont);
     lv_obj_set_size(back_btn, 60, 40);
@@ -91,6 +120,7 @@ mv_page_err_code Waveform_sub_page_deinit(void) {
     if (canvas) { lv_obj_del(canvas); canvas = NULL; }
     if (wave_cont) { lv_obj_del(wave_cont); wave_cont = NULL; }
     if (cbuf) { free(cbuf); cbuf = NULL; }
+    if (bg_layer) { free(bg_layer); bg_layer = NULL; }
     return MV_PAGE_RET_OK;
 }
 
@@ -102,15 +132,15 @@ static void draw_oscilloscope_grid() {
     grid_dsc.color = CRT_GRID_COLOR; 
     grid_dsc.opa = LV_OPA_30; // Rất mờ
 
-    int step_x = canvas_w / 10;
-    for (int i = 1; i < 10; i++) {
+    int step_x = canvas_w / GRID_COLS;
+    for (int i = 1; i < GRID_COLS; i++) {
         lv_point_t p1 = {i * step_x, 0};
         lv_point_t p2 = {i * step_x, canvas_h};
         lv_point_t points[2] = {p1, p2};
         lv_canvas_draw_line(canvas, points, 2, &grid_dsc);
     }
-    int step_y = canvas_h / 8;
-    for (int i = 1; i < 8; i++) {
+    int step_y = canvas_h / GRID_ROWS;
+    for (int i = 1; i < GRID_ROWS; i++) {
         lv_point_t p1 = {0, i * step_y};
         lv_point_t p2 = {canvas_w, i * step_y};
         lv_point_t points[2] = {p1, p2};
@@ -125,6 +155,11 @@ static void draw_oscilloscope_grid() {
     lv_canvas_draw_line(canvas, mp, 2, &grid_dsc);
 }
 
+// Phục hồi nền (màu nền + lưới) ở cột x, hàng [y1, y2] từ lớp nền dựng sẵn
+static void restore_background(int x, int y1, int y2) {
+    canvas_copy_vspan(cbuf, bg_layer, canvas_w, canvas_h, x, y1, y2);
+}
+
 // --- THUẬT TOÁN CATMULL-ROM SPLINE ---
 static float catmull_rom(float p0, float p1, float p2, float p3, float t) {
     float v0 = (p2 - p0) * 0.5f;
@@ -134,20 +169,14 @@ static float catmull_rom(float p0, float p1, float p2, float p3, float t) {
     return (2 * p1 - 2 * p2 + v0 + v1) * t3 + (-3 * p1 + 3 * p2 - 2 * v0 - v1) * t2 + v0 * t + p1;
 }
 
-// --- UPDATE ---
-mv_page_err_code Waveform_sub_page_main_function(mv_value_t *value) {
-    if (!canvas || !value || !value->value) return MV_PAGE_RET_FAIL;
-
-    // 1. Xóa màn hình (Dùng màu nền CRT mới)
-    lv_canvas_fill_bg(canvas, CRT_BG_COLOR, LV_OPA_COVER);
-    draw_oscilloscope_grid();
-
+// --- ĐƯỜNG SÓNG TỪ PHỔ (khi frame không có dữ liệu scope) ---
+static void trace_from_spectrum(const mv_value_t *value) {
     int center_y = canvas_h / 2;
-    
+
     // --- BƯỚC 1: LẤY DỮ LIỆU & LÀM MƯỢT ---
     for (int i = 0; i < POINT_COUNT; i++) {
         int idx = i * (BAR_NUMBER / POINT_COUNT);
-        float raw = value->value[idx];
+        float raw = (idx < value->length) ? value->value[idx] : 0.0f;
         if (raw < 0) raw = -raw;
 
         prev_values[i] = prev_values[i] * 0.5f + raw * 0.5f;
@@ -163,18 +192,12 @@ mv_page_err_code Waveform_sub_page_main_function(mv_value_t *value) {
         }
     }
 
-    // --- BƯỚC 2: VẼ ĐƯỜNG CONG (SPLINE DRAWING) ---
-    lv_draw_line_dsc_t line_dsc;
-    lv_draw_line_dsc_init(&line_dsc);
-    // [SỬA ĐỘ DÀY VÀ MÀU SẮC SÓNG]
-    line_dsc.width = 4; // Tăng độ dày lên 4 để trông "phát sáng" hơn
-    line_dsc.color = CRT_TRACE_COLOR; // Xanh neon rực rỡ
-    line_dsc.round_start = 1;
-    line_dsc.round_end = 1;
-
-    lv_point_t prev_point = {0, center_y - (int)smooth_data[0]};
-    
+    // --- BƯỚC 2: TÍNH ĐƯỜNG CONG (SPLINE) ---
+    // Điểm spline mỗi draw_step px, nội suy tuyến tính cho các cột ở giữa
     int draw_step = 2; 
+    int prev_x = 0;
+    int prev_y = center_y - (int)smooth_data[0];
+    trace_top[0] = trace_bottom[0] = (int16_t)prev_y;
 
     for (int x = draw_step; x < canvas_w; x += draw_step) {
         
@@ -191,13 +214,94 @@ mv_page_err_code Waveform_sub_page_main_function(mv_value_t *value) {
         float spline_y = catmull_rom(p0, p1, p2, p3, t);
         
         int y = center_y - (int)spline_y;
-        lv_point_t current_point = {x, y};
+        for (int cx = prev_x + 1; cx <= x; cx++) {
+            trace_top[cx] = trace_bottom[cx] = (int16_t)(prev_y + (y - prev_y) * (cx - prev_x) / (x - prev_x));
+        }
 
-        lv_point_t line_points[2] = {prev_point, current_point};
-        lv_canvas_draw_line(canvas, line_points, 2, &line_dsc);
+        prev_x = x;
+        prev_y = y;
+    }
+    for (int cx = prev_x + 1; cx < canvas_w; cx++) trace_top[cx] = trace_bottom[cx] = (int16_t)prev_y;
+}
+
+// --- ĐƯỜNG SÓNG THẬT (TIME-DOMAIN) ---
+// Mỗi cột phủ length/canvas_w mẫu: lấy min/max qua pyramid của MusicProcessor,
+// nên chi phí theo độ rộng màn hình chứ không theo số mẫu
+static void trace_from_scope(const mp_scope_t *scope) {
+    int center_y = canvas_h / 2;
+    float amp = (float)(canvas_h / 2 - 5);
+
+    for (int x = 0; x < canvas_w; x++) {
+        int first = (int)((int64_t)x * scope->length / canvas_w);
+        int last = (int)((int64_t)(x + 1) * scope->length / canvas_w) + 1; // +1: nối với cột sau
+        float lo, hi;
+        mp_scope_minmax(scope, first, last, &lo, &hi);
+        trace_top[x] = (int16_t)(center_y - (int)(hi * amp));
+        trace_bottom[x] = (int16_t)(center_y - (int)(lo * amp));
+    }
+}
+
+// --- UPDATE ---
+mv_page_err_code Waveform_sub_page_main_function(mv_value_t *value) {
+    if (!canvas || !bg_layer || !value || !value->value) return MV_PAGE_RET_FAIL;
+
+    if (value->frame && value->frame->scope.length > 0) {
+        trace_from_scope(&value->frame->scope);
+    } else {
+        trace_from_spectrum(value);
+    }
+
+    // --- BƯỚC 3: VẼ (CHỈ CÁC HÀNG THAY ĐỔI) ---
+    // Mỗi cột là một đoạn dọc: min/max của đường sóng trong bán kính
+    // TRACE_WIDTH/2 cột, nới thêm TRACE_WIDTH/2 hàng (nét dày TRACE_WIDTH px)
+    int half = TRACE_WIDTH / 2;
+    int strip_w = (canvas_w + DIRTY_STRIPS - 1) / DIRTY_STRIPS;
+    int dirty_top[DIRTY_STRIPS], dirty_bottom[DIRTY_STRIPS];
+    for (int k = 0; k < DIRTY_STRIPS; k++) {
+        dirty_top[k] = canvas_h;
+        dirty_bottom[k] = -1;
+    }
+
+    for (int x = 0; x < canvas_w; x++) {
+        int y_min = trace_top[x], y_max = trace_bottom[x];
+        for (int cx = LV_MAX(x - half, 0); cx <= LV_MIN(x + half, canvas_w - 1); cx++) {
+            y_min = LV_MIN(y_min, trace_top[cx]);
+            y_max = LV_MAX(y_max, trace_bottom[cx]);
+        }
+        int top = LV_MAX(y_min - half, 0);
+        int bottom = LV_MIN(y_max + half - 1, canvas_h - 1);
+
+        int old_top = span_top[x], old_bottom = span_bottom[x];
+        if (top == old_top && bottom == old_bottom) continue;
+
+        if (old_top <= old_bottom) {
+            // Phục hồi nền ở phần cũ không còn thuộc đường sóng
+            if (old_top < top)       restore_background(x, old_top, LV_MIN(old_bottom, top - 1));
+            if (bottom < old_bottom) restore_background(x, LV_MAX(bottom + 1, old_top), old_bottom);
+            // Tô phần mới
+            if (top < old_top)       canvas_fill_vspan(cbuf, canvas_w, canvas_h, x, top, LV_MIN(bottom, old_top - 1), CRT_TRACE_COLOR);
+            if (old_bottom < bottom) canvas_fill_vspan(cbuf, canvas_w, canvas_h, x, LV_MAX(old_bottom + 1, top), bottom, CRT_TRACE_COLOR);
+        } else {
+            canvas_fill_vspan(cbuf, canvas_w, canvas_h, x, top, bottom, CRT_TRACE_COLOR);
+            old_top = top;
+            old_bottom = bottom;
+        }
+
+        span_top[x] = (int16_t)top;
+        span_bottom[x] = (int16_t)bottom;
+
+        int k = x / strip_w;
+        dirty_top[k] = LV_MIN(dirty_top[k], LV_MIN(top, old_top));
+        dirty_bottom[k] = LV_MAX(dirty_bottom[k], LV_MAX(bottom, old_bottom));
+    }
 
-        prev_point = current_point;
+    canvas_dirty_t dirty;
+    canvas_dirty_reset(&dirty);
+    for (int k = 0; k < DIRTY_STRIPS; k++) {
+        canvas_dirty_add(&dirty, k * strip_w, dirty_top[k],
+                         LV_MIN((k + 1) * strip_w, canvas_w) - 1, dirty_bottom[k]);
     }
+    canvas_dirty_invalidate(canvas, &dirty);
 
     return MV_PAGE_RET_OK;
 }
@@ -11,6 +11,7 @@
 // Nếu bạn đã implement mp_get_bands32 thì mở include này.
 // Nếu chưa làm FFT->bands32, cứ để comment và chạy use_fft=0 (pattern).
 #include "musicprocessor.h"
+#include "profiler.h"
 
 static int g_fd = -1;
 static const int g_n = 4;          // 8x32 => 4 chips
@@ -123,17 +124,29 @@ static uint8_t to_h(float v01) {
 static void* thread_fn(void* _) {
     (void)_;
     uint8_t heights[32];
-    float bands[32];
+    uint64_t last_seq = 0;
 
     while (g_run) {
         if (!g_use_fft) {
             // Pattern mode
             led_test_sweep_once(40, g_flip_x, g_flip_y);
         } else {
-            // FFT mode: cần mp_get_bands32()
-            mp_get_bands32(bands);
-            for (int i = 0; i < 32; i++) heights[i] = to_h(bands[i]);
+            // FFT mode: bands32 của frame mới nhất (như mp_get_bands32()),
+            // kèm thời điểm capture để đo latency âm thanh -> LED
+            const mp_frame_t* frame = mp_acquire_frame();
+            uint64_t capture_ns = 0;
+            if (frame) {
+                for (int i = 0; i < 32; i++) heights[i] = to_h(frame->features.bands32[i]);
+                if (frame->seq != last_seq) capture_ns = frame->timestamp_ns;
+                last_seq = frame->seq;
+            } else {
+                memset(heights, 0, sizeof(heights));
+            }
+            mp_release_frame(frame);
+
             led_draw_columns(heights, g_flip_x, g_flip_y);
+            // SPI write() đã xong: frame mới đang hiển thị trên LED
+            if (capture_ns && g_prof_enabled) prof_record(PROF_STAGE_PHOTON_LED, capture_ns, prof_now_ns());
             usleep(33000); // ~30fps
         }
     }
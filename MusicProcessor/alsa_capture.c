@@ -0,0 +1,144 @@
+#include "alsa_capture.h"
+#include <stdio.h>
+#include <string.h>
+#include <alsa/asoundlib.h>
+
+static int alsa_capture_recover(alsa_capture_t *cap, int err) {
+    snd_pcm_t *pcm = (snd_pcm_t *)cap->pcm;
+    // Interrupted by a signal or nothing ready yet: the stream is still running
+    if (err == -EINTR || err == -EAGAIN) return 0;
+    if (err == -EPIPE) cap->xruns++;
+
+    err = snd_pcm_recover(pcm, err, 1);
+    if (err < 0) {
+        fprintf(stderr, "ALSA capture recover failed: %s\n", snd_strerror(err));
+        return err;
+    }
+    // Capture streams do not restart by themselves after prepare; a resumed
+    // stream (-ESTRPIPE) is already running
+    if (snd_pcm_state(pcm) != SND_PCM_STATE_PREPARED) return 0;
+    err = snd_pcm_start(pcm);
+    return err < 0 ? err : 0;
+}
+
+int alsa_capture_open(alsa_capture_t *cap, const char *device, int sample_rate, int channels,
+                      int period_frames, int buffer_frames) {
+    snd_pcm_t *pcm = NULL;
+    snd_pcm_hw_params_t *hw;
+    snd_pcm_sw_params_t *sw;
+    unsigned int rate = (unsigned int)sample_rate;
+    snd_pcm_uframes_t period = (snd_pcm_uframes_t)period_frames;
+    snd_pcm_uframes_t buffer = (snd_pcm_uframes_t)buffer_frames;
+    int err;
+
+    memset(cap, 0, sizeof(*cap));
+
+    err = snd_pcm_open(&pcm, device ? device : "default", SND_PCM_STREAM_CAPTURE, 0);
+    if (err < 0) {
+        fprintf(stderr, "Cannot open ALSA device %s: %s\n", device, snd_strerror(err));
+        return -1;
+    }
+
+    snd_pcm_hw_params_alloca(&hw);
+    snd_pcm_hw_params_any(pcm, hw);
+    if ((err = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_MMAP_INTERLEAVED)) < 0 ||
+        (err = snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16_LE)) < 0 ||
+        (err = snd_pcm_hw_params_set_channels(pcm, hw, (unsigned int)channels)) < 0 ||
+        (err = snd_pcm_hw_params_set_rate_near(pcm, hw, &rate, NULL)) < 0 ||
+        (err = snd_pcm_hw_params_set_period_size_near(pcm, hw, &period, NULL)) < 0 ||
+        (err = snd_pcm_hw_params_set_buffer_size_near(pcm, hw, &buffer)) < 0 ||
+        (err = snd_pcm_hw_params(pcm, hw)) < 0) {
+        fprintf(stderr, "Cannot configure ALSA device %s: %s\n", device, snd_strerror(err));
+        snd_pcm_close(pcm);
+        return -1;
+    }
+    snd_pcm_hw_params_get_period_size(hw, &period, NULL);
+    snd_pcm_hw_params_get_buffer_size(hw, &buffer);
+    if (period != (snd_pcm_uframes_t)period_frames || buffer != (snd_pcm_uframes_t)buffer_frames) {
+        fprintf(stderr, "ALSA device %s adjusted period %d -> %lu, buffer %d -> %lu frames\n",
+                device, period_frames, (unsigned long)period, buffer_frames, (unsigned long)buffer);
+    }
+
+    // Wake up once per period
+    snd_pcm_sw_params_alloca(&sw);
+    snd_pcm_sw_params_current(pcm, sw);
+    snd_pcm_sw_params_set_avail_min(pcm, sw, period);
+    // Timestamp every period on the monotonic clock, used for latency measurement
+    int tstamp_monotonic = snd_pcm_sw_params_set_tstamp_mode(pcm, sw, SND_PCM_TSTAMP_ENABLE) == 0 &&
+        snd_pcm_sw_params_set_tstamp_type(pcm, sw, SND_PCM_TSTAMP_TYPE_MONOTONIC) == 0;
+    if ((err = snd_pcm_sw_params(pcm, sw)) < 0 ||
+        (err = snd_pcm_prepare(pcm)) < 0 ||
+        (err = snd_pcm_start(pcm)) < 0) {
+        fprintf(stderr, "Cannot start ALSA device %s: %s\n", device, snd_strerror(err));
+        snd_pcm_close(pcm);
+        return -1;
+    }
+
+    cap->pcm = pcm;
+    cap->sample_rate = (int)rate;
+    cap->channels = channels;
+    cap->period_frames = period;
+    cap->buffer_frames = buffer;
+    cap->tstamp_monotonic = tstamp_monotonic;
+    printf("ALSA capture: %s, %u Hz, period %lu, buffer %lu frames\n",
+           device, rate, (unsigned long)period, (unsigned long)buffer);
+    return 0;
+}
+
+int alsa_capture_read(alsa_capture_t *cap, int16_t *dst, int max_frames, int timeout_ms) {
+    snd_pcm_t *pcm = (snd_pcm_t *)cap->pcm;
+    const size_t frame_bytes = (size_t)cap->channels * sizeof(int16_t);
+    snd_pcm_uframes_t want = cap->period_frames;
+    cap->capture_ns = 0;
+    if (max_frames <= 0) return 0;
+    if (want > (snd_pcm_uframes_t)max_frames) want = (snd_pcm_uframes_t)max_frames;
+
+    snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+    if (avail < 0) {
+        return alsa_capture_recover(cap, (int)avail) < 0 ? -1 : 0;
+    }
+    if ((snd_pcm_uframes_t)avail < want) {
+        int err = snd_pcm_wait(pcm, timeout_ms);
+        if (err < 0) return alsa_capture_recover(cap, err) < 0 ? -1 : 0;
+        avail = snd_pcm_avail_update(pcm);
+        if (avail < 0) return alsa_capture_recover(cap, (int)avail) < 0 ? -1 : 0;
+        if ((snd_pcm_uframes_t)avail < want) return 0;
+    }
+
+    // The buffer held ts_avail frames at tstamp; the newest one we copy is
+    // (ts_avail - want) frames older than that
+    snd_pcm_uframes_t ts_avail;
+    snd_htimestamp_t tstamp;
+    if (cap->tstamp_monotonic && snd_pcm_htimestamp(pcm, &ts_avail, &tstamp) == 0 &&
+        (tstamp.tv_sec || tstamp.tv_nsec) && ts_avail >= want && cap->sample_rate > 0) {
+        uint64_t ts_ns = (uint64_t)tstamp.tv_sec * 1000000000ull + (uint64_t)tstamp.tv_nsec;
+        uint64_t behind_ns = (uint64_t)(ts_avail - want) * 1000000000ull / (uint64_t)cap->sample_rate;
+        cap->capture_ns = ts_ns > behind_ns ? ts_ns - behind_ns : 0;
+    }
+
+    // The mmap area may wrap: copy in up to two pieces straight from the DMA buffer
+    snd_pcm_uframes_t copied = 0;
+    while (copied < want) {
+        const snd_pcm_channel_area_t *areas;
+        snd_pcm_uframes_t offset;
+        snd_pcm_uframes_t frames = want - copied;
+        int err = snd_pcm_mmap_begin(pcm, &areas, &offset, &frames);
+        if (err < 0) return alsa_capture_recover(cap, err) < 0 ? -1 : (int)copied;
+
+        const uint8_t *src = (const uint8_t *)areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
+        memcpy((uint8_t *)dst + copied * frame_bytes, src, frames * frame_bytes);
+
+        snd_pcm_sframes_t done = snd_pcm_mmap_commit(pcm, offset, frames);
+        if (done < 0 || (snd_pcm_uframes_t)done != frames) {
+            return alsa_capture_recover(cap, done < 0 ? (int)done : -EPIPE) < 0 ? -1 : (int)copied;
+        }
+        copied += frames;
+    }
+    return (int)copied;
+}
+
+void alsa_capture_close(alsa_capture_t *cap) {
+    if (!cap || !cap->pcm) return;
+    snd_pcm_close((snd_pcm_t *)cap->pcm);
+    cap->pcm = NULL;
+}
@@ -0,0 +1,41 @@
+#ifndef ALSA_CAPTURE_H
+#define ALSA_CAPTURE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Native ALSA capture through the mmap interface (snd_pcm_mmap_begin/commit).
+// Samples are interleaved S16_LE; one read returns at most one period, so the
+// capture latency is bounded by the period size.
+typedef struct {
+    void *pcm;                  // snd_pcm_t*
+    int sample_rate;            // negotiated rate
+    int channels;
+    unsigned long period_frames; // negotiated period size
+    unsigned long buffer_frames; // negotiated buffer size
+    uint64_t xruns;             // overruns recovered so far
+    int tstamp_monotonic;       // driver timestamps are CLOCK_MONOTONIC
+    uint64_t capture_ns;        // CLOCK_MONOTONIC capture time of the last frame returned
+                                // by alsa_capture_read(), 0 if the driver gave no timestamp
+} alsa_capture_t;
+
+// Open and start the capture device. period_frames/buffer_frames are hints,
+// the values the driver accepted are stored in `cap`. Returns 0 on success.
+int alsa_capture_open(alsa_capture_t *cap, const char *device, int sample_rate, int channels,
+                      int period_frames, int buffer_frames);
+
+// Copy up to max_frames (at most one period) into dst, waiting up to
+// timeout_ms for a period to become ready.
+// Returns frames copied, 0 on timeout, negative on an unrecoverable error.
+int alsa_capture_read(alsa_capture_t *cap, int16_t *dst, int max_frames, int timeout_ms);
+
+void alsa_capture_close(alsa_capture_t *cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ALSA_CAPTURE_H
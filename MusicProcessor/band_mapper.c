@@ -0,0 +1,149 @@
+#include "band_mapper.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define BAND_MAPPER_SMOOTHING 0.80f
+
+static double band_to_scale(band_scale_t scale, double f) {
+    switch (scale) {
+        case BAND_SCALE_MEL:  return 2595.0 * log10(1.0 + f / 700.0);
+        case BAND_SCALE_BARK: return 26.81 * f / (1960.0 + f) - 0.53;
+        default:              return log(f);
+    }
+}
+
+static double band_from_scale(band_scale_t scale, double z) {
+    switch (scale) {
+        case BAND_SCALE_MEL:  return 700.0 * (pow(10.0, z / 2595.0) - 1.0);
+        case BAND_SCALE_BARK: return 1960.0 * (z + 0.53) / (26.28 - z);
+        default:              return exp(z);
+    }
+}
+
+void band_mapper_free(band_mapper_t *m) {
+    if (!m) return;
+    free(m->first_bin);
+    free(m->offset);
+    free(m->weights);
+    free(m->smooth);
+    memset(m, 0, sizeof(*m));
+}
+
+int band_mapper_init(band_mapper_t *m, int bands, int fft_size, int sample_rate,
+                     band_scale_t scale, float f_min, float f_max, const float *edges) {
+    if (!m) return -1;
+    memset(m, 0, sizeof(*m));
+    if (bands <= 0 || fft_size <= 0 || sample_rate <= 0) return -1;
+    if (scale == BAND_SCALE_CUSTOM && !edges) return -1;
+
+    const int bins = fft_size / 2 + 1;
+    const double bin_hz = (double)sample_rate / (double)fft_size;
+    const double nyquist = (double)sample_rate / 2.0;
+
+    // Edge frequencies in Hz
+    double *hz = (double *)malloc((size_t)(bands + 2) * sizeof(double));
+    if (!hz) return -1;
+    if (scale == BAND_SCALE_CUSTOM) {
+        for (int i = 0; i < bands + 2; i++) hz[i] = edges[i];
+    } else {
+        double lo = f_min > 0.0f ? f_min : bin_hz;
+        double hi = (f_max > 0.0f && f_max <= nyquist) ? f_max : nyquist;
+        if (hi <= lo) hi = nyquist;
+        double z0 = band_to_scale(scale, lo);
+        double z1 = band_to_scale(scale, hi);
+        for (int i = 0; i < bands + 2; i++) {
+            hz[i] = band_from_scale(scale, z0 + (z1 - z0) * (double)i / (double)(bands + 1));
+        }
+    }
+
+    m->bands = bands;
+    m->bins = bins;
+    m->smoothing = BAND_MAPPER_SMOOTHING;
+    m->first_bin = (int *)malloc((size_t)bands * sizeof(int));
+    m->offset = (int *)malloc((size_t)(bands + 1) * sizeof(int));
+    m->smooth = (float *)calloc((size_t)bands, sizeof(float));
+    if (!m->first_bin || !m->offset || !m->smooth) {
+        free(hz);
+        band_mapper_free(m);
+        return -1;
+    }
+
+    // Pass 1: bin range of every triangle (at least one bin, so narrow bass bands are never empty)
+    int total = 0;
+    for (int b = 0; b < bands; b++) {
+        int first = (int)ceil(hz[b] / bin_hz);
+        int last = (int)floor(hz[b + 2] / bin_hz);
+        if (first < 0) first = 0;
+        if (last > bins - 1) last = bins - 1;
+        if (last < first) {
+            first = (int)lround(hz[b + 1] / bin_hz);
+            if (first > bins - 1) first = bins - 1;
+            if (first < 0) first = 0;
+            last = first;
+        }
+        m->first_bin[b] = first;
+        m->offset[b] = total;
+        total += last - first + 1;
+    }
+    m->offset[bands] = total;
+
+    // Pass 2: triangular weights normalized to unit sum
+    m->weights = (float *)malloc((size_t)total * sizeof(float));
+    if (!m->weights) {
+        free(hz);
+        band_mapper_free(m);
+        return -1;
+    }
+    for (int b = 0; b < bands; b++) {
+        const int count = m->offset[b + 1] - m->offset[b];
+        float *w = m->weights + m->offset[b];
+        const double left = hz[b], center = hz[b + 1], right = hz[b + 2];
+        double sum = 0.0;
+        for (int k = 0; k < count; k++) {
+            double f = (double)(m->first_bin[b] + k) * bin_hz;
+            double v;
+            if (f <= center) v = (center > left) ? (f - left) / (center - left) : 1.0;
+            else             v = (right > center) ? (right - f) / (right - center) : 1.0;
+            if (v < 0.0) v = 0.0;
+            w[k] = (float)v;
+            sum += v;
+        }
+        if (sum <= 0.0) {
+            for (int k = 0; k < count; k++) w[k] = 1.0f / (float)count;
+        } else {
+            for (int k = 0; k < count; k++) w[k] = (float)(w[k] / sum);
+        }
+    }
+
+    free(hz);
+    return 0;
+}
+
+void band_mapper_apply(const band_mapper_t *m, const float *mag, float *out) {
+    for (int b = 0; b < m->bands; b++) {
+        const float *w = m->weights + m->offset[b];
+        const float *x = mag + m->first_bin[b];
+        const int count = m->offset[b + 1] - m->offset[b];
+        float sum = 0.0f;
+        for (int k = 0; k < count; k++) sum += w[k] * x[k];
+        out[b] = sum;
+    }
+}
+
+void band_mapper_process(band_mapper_t *m, const float *mag, float *out) {
+    band_mapper_apply(m, mag, out);
+
+    // Normalize theo max (tránh chia 0)
+    float mx = 1e-9f;
+    for (int b = 0; b < m->bands; b++) if (out[b] > mx) mx = out[b];
+
+    // EMA smoothing + compress (sqrt) để nhìn đều hơn
+    const float a = m->smoothing;
+    const float inv = 1.0f / mx;
+    for (int b = 0; b < m->bands; b++) {
+        float v = sqrtf(out[b] * inv);
+        m->smooth[b] = a * m->smooth[b] + (1.0f - a) * v;
+        out[b] = m->smooth[b];
+    }
+}
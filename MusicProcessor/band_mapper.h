@@ -0,0 +1,53 @@
+#ifndef BAND_MAPPER_H
+#define BAND_MAPPER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Frequency scale used to place the band edges
+typedef enum {
+    BAND_SCALE_LOG = 0,   // equal ratio between neighbouring bands
+    BAND_SCALE_MEL,       // 2595 * log10(1 + f / 700)
+    BAND_SCALE_BARK,      // Traunmüller critical-band rate
+    BAND_SCALE_CUSTOM     // caller supplied edges
+} band_scale_t;
+
+// Magnitude spectrum -> N bands through sparse triangular weights.
+// Band i rises from edge i to edge i + 1 and falls to edge i + 2 (N + 2 edges),
+// like a mel filterbank. Weights are stored per band as one contiguous run of
+// bins, so a reduction is a single forward pass over the spectrum.
+// Tables are built once; each instance also owns its smoothing state, so give
+// every consumer its own mapper.
+typedef struct {
+    int bands;
+    int bins;             // spectrum length the tables were built for (fft_size/2 + 1)
+    int *first_bin;       // per band: first bin with a non-zero weight
+    int *offset;          // per band: start of its run in weights, offset[bands] = total
+    float *weights;       // runs of per-bin weights, each run sums to 1
+    float *smooth;        // per band EMA state (band_mapper_process)
+    float smoothing;      // EMA coefficient, 0 = no smoothing
+} band_mapper_t;
+
+// Build the tables. f_min/f_max bound the first and last edge (ignored for
+// BAND_SCALE_CUSTOM, which reads bands + 2 ascending edges in Hz from `edges`).
+// Returns 0 on success.
+int band_mapper_init(band_mapper_t *m, int bands, int fft_size, int sample_rate,
+                     band_scale_t scale, float f_min, float f_max, const float *edges);
+
+void band_mapper_free(band_mapper_t *m);
+
+// Raw weighted band magnitudes: out[i] = sum(w * mag[bin]) over band i
+void band_mapper_apply(const band_mapper_t *m, const float *mag, float *out);
+
+// Visualizer levels in [0..1]: apply(), normalize by the loudest band,
+// compress with sqrt and smooth with the instance EMA
+void band_mapper_process(band_mapper_t *m, const float *mag, float *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BAND_MAPPER_H
@@ -0,0 +1,203 @@
+#include "dsp.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DSP_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define DSP_USE_SSE 1
+#endif
+
+void dsp_mul_f32(float *dst, const float *a, const float *b, size_t n) {
+    size_t i = 0;
+#if defined(DSP_USE_NEON)
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t a0 = vld1q_f32(a + i);
+        float32x4_t a1 = vld1q_f32(a + i + 4);
+        float32x4_t b0 = vld1q_f32(b + i);
+        float32x4_t b1 = vld1q_f32(b + i + 4);
+        vst1q_f32(dst + i, vmulq_f32(a0, b0));
+        vst1q_f32(dst + i + 4, vmulq_f32(a1, b1));
+    }
+#elif defined(DSP_USE_SSE)
+    for (; i + 8 <= n; i += 8) {
+        __m128 a0 = _mm_loadu_ps(a + i);
+        __m128 a1 = _mm_loadu_ps(a + i + 4);
+        __m128 b0 = _mm_loadu_ps(b + i);
+        __m128 b1 = _mm_loadu_ps(b + i + 4);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(a0, b0));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(a1, b1));
+    }
+#endif
+    // Tail (and scalar fallback)
+    for (; i < n; i++) {
+        dst[i] = a[i] * b[i];
+    }
+}
+
+void dsp_s16_to_f32(float *dst, const int16_t *src, size_t n, float scale) {
+    size_t i = 0;
+#if defined(DSP_USE_NEON)
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(src + i);
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)));
+        vst1q_f32(dst + i, vmulq_n_f32(lo, scale));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(hi, scale));
+    }
+#elif defined(DSP_USE_SSE)
+    const __m128 vs = _mm_set1_ps(scale);
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        // Sign-extend: put each s16 in the high half of a 32-bit lane, shift back
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vs));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vs));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = (float)src[i] * scale;
+    }
+}
+
+void dsp_s32_to_f32(float *dst, const int32_t *src, size_t n, float scale) {
+    size_t i = 0;
+#if defined(DSP_USE_NEON)
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t a = vcvtq_f32_s32(vld1q_s32(src + i));
+        float32x4_t b = vcvtq_f32_s32(vld1q_s32(src + i + 4));
+        vst1q_f32(dst + i, vmulq_n_f32(a, scale));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(b, scale));
+    }
+#elif defined(DSP_USE_SSE)
+    const __m128 vs = _mm_set1_ps(scale);
+    for (; i + 8 <= n; i += 8) {
+        __m128 a = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(src + i)));
+        __m128 b = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(src + i + 4)));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(a, vs));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(b, vs));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = (float)src[i] * scale;
+    }
+}
+
+void dsp_scale_f32(float *dst, const float *src, size_t n, float scale) {
+    size_t i = 0;
+#if defined(DSP_USE_NEON)
+    for (; i + 8 <= n; i += 8) {
+        vst1q_f32(dst + i, vmulq_n_f32(vld1q_f32(src + i), scale));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(vld1q_f32(src + i + 4), scale));
+    }
+#elif defined(DSP_USE_SSE)
+    const __m128 vs = _mm_set1_ps(scale);
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), vs));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_loadu_ps(src + i + 4), vs));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = src[i] * scale;
+    }
+}
+
+void dsp_add_f32(float *dst, const float *src, size_t n) {
+    size_t i = 0;
+#if defined(DSP_USE_NEON)
+    for (; i + 8 <= n; i += 8) {
+        vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vld1q_f32(src + i)));
+        vst1q_f32(dst + i + 4, vaddq_f32(vld1q_f32(dst + i + 4), vld1q_f32(src + i + 4)));
+    }
+#elif defined(DSP_USE_SSE)
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), _mm_loadu_ps(src + i + 4)));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] += src[i];
+    }
+}
+
+void dsp_mix2_f32(float *dst, const float *src, size_t frames) {
+    size_t i = 0;
+#if defined(DSP_USE_NEON)
+    for (; i + 4 <= frames; i += 4) {
+        float32x4x2_t lr = vld2q_f32(src + 2 * i);   // de-interleaves L and R
+        vst1q_f32(dst + i, vaddq_f32(lr.val[0], lr.val[1]));
+    }
+#elif defined(DSP_USE_SSE)
+    for (; i + 4 <= frames; i += 4) {
+        __m128 a = _mm_loadu_ps(src + 2 * i);        // l0 r0 l1 r1
+        __m128 b = _mm_loadu_ps(src + 2 * i + 4);    // l2 r2 l3 r3
+        __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(dst + i, _mm_add_ps(l, r));
+    }
+#endif
+    for (; i < frames; i++) {
+        dst[i] = src[2 * i] + src[2 * i + 1];
+    }
+}
+
+void dsp_clamp_f32(float *dst, size_t n, float lo, float hi) {
+    size_t i = 0;
+#if defined(DSP_USE_NEON)
+    const float32x4_t vlo = vdupq_n_f32(lo);
+    const float32x4_t vhi = vdupq_n_f32(hi);
+    for (; i + 8 <= n; i += 8) {
+        vst1q_f32(dst + i, vminq_f32(vmaxq_f32(vld1q_f32(dst + i), vlo), vhi));
+        vst1q_f32(dst + i + 4, vminq_f32(vmaxq_f32(vld1q_f32(dst + i + 4), vlo), vhi));
+    }
+#elif defined(DSP_USE_SSE)
+    const __m128 vlo = _mm_set1_ps(lo);
+    const __m128 vhi = _mm_set1_ps(hi);
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(dst + i), vlo), vhi));
+        _mm_storeu_ps(dst + i + 4, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(dst + i + 4), vlo), vhi));
+    }
+#endif
+    for (; i < n; i++) {
+        float x = dst[i];
+        if (x > hi) x = hi;
+        if (x < lo) x = lo;
+        dst[i] = x;
+    }
+}
+
+float dsp_sumsq_f32(const float *x, size_t n) {
+    size_t i = 0;
+    float sum = 0.0f;
+#if defined(DSP_USE_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t a = vld1q_f32(x + i);
+        float32x4_t b = vld1q_f32(x + i + 4);
+        acc0 = vmlaq_f32(acc0, a, a);
+        acc1 = vmlaq_f32(acc1, b, b);
+    }
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+    float lanes[4];
+    vst1q_f32(lanes, acc);
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(DSP_USE_SSE)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        __m128 a = _mm_loadu_ps(x + i);
+        __m128 b = _mm_loadu_ps(x + i + 4);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(a, a));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(b, b));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for (; i < n; i++) {
+        sum += x[i] * x[i];
+    }
+    return sum;
+}
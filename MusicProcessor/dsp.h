@@ -0,0 +1,40 @@
+#ifndef DSP_H
+#define DSP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Vectorized DSP kernels (NEON on the Pi, SSE on x86, scalar fallback).
+// Pointers do not need any particular alignment.
+
+// dst[i] = a[i] * b[i]
+void dsp_mul_f32(float *dst, const float *a, const float *b, size_t n);
+
+// dst[i] = src[i] * scale (integer PCM -> float)
+void dsp_s16_to_f32(float *dst, const int16_t *src, size_t n, float scale);
+void dsp_s32_to_f32(float *dst, const int32_t *src, size_t n, float scale);
+
+// dst[i] = src[i] * scale (dst may equal src)
+void dsp_scale_f32(float *dst, const float *src, size_t n, float scale);
+
+// dst[i] += src[i]
+void dsp_add_f32(float *dst, const float *src, size_t n);
+
+// Interleaved stereo -> mono: dst[i] = src[2i] + src[2i+1]
+void dsp_mix2_f32(float *dst, const float *src, size_t frames);
+
+// sum(x[i] * x[i])
+float dsp_sumsq_f32(const float *x, size_t n);
+
+// dst[i] = min(max(dst[i], lo), hi)
+void dsp_clamp_f32(float *dst, size_t n, float lo, float hi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DSP_H
@@ -0,0 +1,306 @@
+#include "file_source.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/samplefmt.h>
+
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(59, 24, 100)
+#define FILE_SOURCE_AV_CHANNELS(x) ((x)->ch_layout.nb_channels)
+#else
+#define FILE_SOURCE_AV_CHANNELS(x) ((x)->channels)
+#endif
+
+#define WAV_FORMAT_PCM        1
+#define WAV_FORMAT_IEEE_FLOAT 3
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+static mp_file_format_t file_source_guess_format(const char *path) {
+    const char *ext = strrchr(path, '.');
+    if (!ext) return MP_FILE_FFMPEG;
+    if (strcasecmp(ext, ".wav") == 0) return MP_FILE_WAV;
+    if (strcasecmp(ext, ".raw") == 0 || strcasecmp(ext, ".pcm") == 0 || strcasecmp(ext, ".s16") == 0) {
+        return MP_FILE_RAW_S16LE;
+    }
+    if (strcasecmp(ext, ".f32") == 0) return MP_FILE_RAW_F32LE;
+    return MP_FILE_FFMPEG;
+}
+
+static uint32_t read_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t read_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+// Walk the RIFF chunks up to "data"; leaves fp at the first sample
+static int file_source_parse_wav(file_source_t *src) {
+    uint8_t hdr[12];
+    if (fread(hdr, 1, sizeof(hdr), src->fp) != sizeof(hdr) ||
+        memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "Not a RIFF/WAVE file\n");
+        return -1;
+    }
+
+    int have_fmt = 0;
+    for (;;) {
+        uint8_t chunk[8];
+        if (fread(chunk, 1, sizeof(chunk), src->fp) != sizeof(chunk)) {
+            fprintf(stderr, "WAV file has no data chunk\n");
+            return -1;
+        }
+        uint32_t size = read_le32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[40] = {0};
+            size_t n = size < sizeof(fmt) ? size : sizeof(fmt);
+            if (size < 16 || fread(fmt, 1, n, src->fp) != n) return -1;
+            if (size > n) fseek(src->fp, (long)(size - n), SEEK_CUR);
+
+            uint16_t tag = read_le16(fmt);
+            if (tag == WAV_FORMAT_EXTENSIBLE && size >= 26) tag = read_le16(fmt + 24); // SubFormat GUID
+            src->channels = read_le16(fmt + 2);
+            src->sample_rate = (int)read_le32(fmt + 4);
+            uint16_t bits = read_le16(fmt + 14);
+
+            if (tag == WAV_FORMAT_PCM && bits == 16) {
+                src->sample = SAMPLE_FORMAT_S16;
+            } else if (tag == WAV_FORMAT_PCM && bits == 32) {
+                src->sample = SAMPLE_FORMAT_S32;
+            } else if (tag == WAV_FORMAT_IEEE_FLOAT && bits == 32) {
+                src->sample = SAMPLE_FORMAT_F32;
+            } else {
+                fprintf(stderr, "Unsupported WAV encoding (format %u, %u bits)\n", tag, bits);
+                return -1;
+            }
+            have_fmt = 1;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt || src->channels <= 0) {
+                fprintf(stderr, "WAV data chunk before fmt chunk\n");
+                return -1;
+            }
+            src->data_left = size;
+            return 0;
+        } else {
+            fseek(src->fp, (long)(size + (size & 1)), SEEK_CUR);  // chunks are word aligned
+        }
+    }
+}
+
+static int file_source_open_ffmpeg(file_source_t *src, const char *path) {
+    AVFormatContext *fmt_ctx = NULL;
+    int ret = avformat_open_input(&fmt_ctx, path, NULL, NULL);
+    if (ret < 0) {
+        char error_str[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(ret, error_str, sizeof(error_str));
+        fprintf(stderr, "Cannot open %s: %s\n", path, error_str);
+        return -1;
+    }
+    src->fmt_ctx = fmt_ctx;
+
+    if (avformat_find_stream_info(fmt_ctx, NULL) < 0) {
+        fprintf(stderr, "Cannot find stream info in %s\n", path);
+        return -1;
+    }
+
+    const AVCodec *codec = NULL;
+    src->stream_index = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+    if (src->stream_index < 0 || !codec) {
+        fprintf(stderr, "Cannot find audio stream in %s\n", path);
+        return -1;
+    }
+
+    AVCodecContext *codec_ctx = avcodec_alloc_context3(codec);
+    if (!codec_ctx) return -1;
+    src->codec_ctx = codec_ctx;
+    if (avcodec_parameters_to_context(codec_ctx, fmt_ctx->streams[src->stream_index]->codecpar) < 0 ||
+        avcodec_open2(codec_ctx, codec, NULL) < 0) {
+        fprintf(stderr, "Cannot open decoder for %s\n", path);
+        return -1;
+    }
+
+    src->packet = av_packet_alloc();
+    src->frame = av_frame_alloc();
+    if (!src->packet || !src->frame) return -1;
+
+    src->sample = sample_format_from_av(codec_ctx->sample_fmt);
+    if (src->sample == SAMPLE_FORMAT_UNKNOWN) src->sample = SAMPLE_FORMAT_F32;  // repacked
+    src->sample_rate = codec_ctx->sample_rate;
+    src->channels = FILE_SOURCE_AV_CHANNELS(codec_ctx);
+    return src->channels > 0 ? 0 : -1;
+}
+
+int file_source_open(file_source_t *src, const char *path, mp_file_format_t format,
+                     int sample_rate, int channels) {
+    memset(src, 0, sizeof(*src));
+    src->stream_index = -1;
+    if (!path) return -1;
+
+    src->format = (format == MP_FILE_AUTO) ? file_source_guess_format(path) : format;
+    int ok;
+    switch (src->format) {
+        case MP_FILE_FFMPEG:
+            ok = file_source_open_ffmpeg(src, path) == 0;
+            break;
+        case MP_FILE_WAV:
+        case MP_FILE_RAW_S16LE:
+        case MP_FILE_RAW_F32LE:
+            src->fp = fopen(path, "rb");
+            if (!src->fp) {
+                fprintf(stderr, "Cannot open %s\n", path);
+                return -1;
+            }
+            if (src->format == MP_FILE_WAV) {
+                ok = file_source_parse_wav(src) == 0;
+            } else {
+                src->sample = (src->format == MP_FILE_RAW_F32LE) ? SAMPLE_FORMAT_F32 : SAMPLE_FORMAT_S16;
+                src->sample_rate = sample_rate;
+                src->channels = channels;
+                src->data_left = UINT64_MAX;
+                ok = channels > 0 && sample_rate > 0;
+            }
+            break;
+        default:
+            ok = 0;
+            break;
+    }
+    if (!ok) {
+        file_source_close(src);
+        return -1;
+    }
+
+    printf("File source: %s, %d Hz, %d channel(s), %d-bit%s\n", path, src->sample_rate, src->channels,
+           sample_format_bytes(src->sample) * 8, sample_format_is_planar(src->sample) ? " planar" : "");
+    return 0;
+}
+
+// Repack a decoded frame in a format the pipeline does not convert (u8, double) to interleaved float
+static int file_source_repack(file_source_t *src, const AVFrame *frame) {
+    const int ch = src->channels;
+    const int n = frame->nb_samples;
+    const enum AVSampleFormat fmt = (enum AVSampleFormat)frame->format;
+    const int planar = av_sample_fmt_is_planar(fmt);
+
+    if (n > src->repacked_capacity) {
+        float *buf = (float *)realloc(src->repacked, (size_t)n * (size_t)ch * sizeof(float));
+        if (!buf) return -1;
+        src->repacked = buf;
+        src->repacked_capacity = n;
+    }
+
+    for (int c = 0; c < ch; c++) {
+        const uint8_t *plane = planar ? frame->extended_data[c] : frame->extended_data[0];
+        const int stride = planar ? 1 : ch;
+        const int first = planar ? 0 : c;
+        float *out = src->repacked + c;
+        for (int i = 0; i < n; i++) {
+            const int k = i * stride + first;
+            float v;
+            switch (fmt) {
+                case AV_SAMPLE_FMT_U8:  case AV_SAMPLE_FMT_U8P:  v = ((float)plane[k] - 128.0f) / 128.0f; break;
+                case AV_SAMPLE_FMT_DBL: case AV_SAMPLE_FMT_DBLP: v = (float)((const double *)plane)[k]; break;
+                default:
+                    fprintf(stderr, "Unsupported decoded sample format %s\n", av_get_sample_fmt_name(fmt));
+                    return -1;
+            }
+            out[(size_t)i * ch] = v;
+        }
+    }
+    return 0;
+}
+
+// Decode until one frame is available. Returns 1 on success, 0 at EOF, -1 on error.
+static int file_source_decode(file_source_t *src) {
+    AVFormatContext *fmt_ctx = src->fmt_ctx;
+    AVCodecContext *codec_ctx = src->codec_ctx;
+    AVPacket *packet = src->packet;
+    AVFrame *frame = src->frame;
+
+    av_frame_unref(frame);
+    src->pending_frames = 0;
+    src->pending_pos = 0;
+
+    for (;;) {
+        int ret = avcodec_receive_frame(codec_ctx, frame);
+        if (ret == 0) {
+            // The frame stays referenced until all of it has been read
+            src->sample = sample_format_from_av(frame->format);
+            if (src->sample == SAMPLE_FORMAT_UNKNOWN) {
+                src->sample = SAMPLE_FORMAT_F32;
+                if (file_source_repack(src, frame) != 0) return -1;
+            }
+            src->pending_frames = frame->nb_samples;
+            return 1;
+        }
+        if (ret == AVERROR_EOF) return 0;
+        if (ret != AVERROR(EAGAIN)) return -1;
+
+        // Decoder needs more input
+        if (src->eof) return 0;
+        ret = av_read_frame(fmt_ctx, packet);
+        if (ret < 0) {
+            src->eof = 1;
+            avcodec_send_packet(codec_ctx, NULL);   // drain
+            continue;
+        }
+        if (packet->stream_index == src->stream_index) {
+            avcodec_send_packet(codec_ctx, packet);
+        }
+        av_packet_unref(packet);
+    }
+}
+
+int file_source_read(file_source_t *src, void *dst, int max_frames) {
+    if (max_frames <= 0) return 0;
+
+    if (src->format == MP_FILE_FFMPEG) {
+        if (src->pending_pos >= src->pending_frames) {
+            int ret = file_source_decode(src);
+            if (ret <= 0) return ret;
+        }
+        int frames = src->pending_frames - src->pending_pos;
+        if (frames > max_frames) frames = max_frames;
+
+        const size_t bytes = (size_t)sample_format_bytes(src->sample);
+        const enum AVSampleFormat fmt = (enum AVSampleFormat)src->frame->format;
+        if (sample_format_from_av(fmt) == SAMPLE_FORMAT_UNKNOWN) {
+            memcpy(dst, src->repacked + (size_t)src->pending_pos * src->channels,
+                   (size_t)frames * (size_t)src->channels * sizeof(float));
+        } else if (sample_format_is_planar(src->sample)) {
+            for (int c = 0; c < src->channels; c++) {
+                memcpy((uint8_t *)dst + (size_t)c * (size_t)frames * bytes,
+                       src->frame->extended_data[c] + (size_t)src->pending_pos * bytes,
+                       (size_t)frames * bytes);
+            }
+        } else {
+            const size_t frame_bytes = bytes * (size_t)src->channels;
+            memcpy(dst, src->frame->extended_data[0] + (size_t)src->pending_pos * frame_bytes,
+                   (size_t)frames * frame_bytes);
+        }
+        src->pending_pos += frames;
+        return frames;
+    }
+
+    // WAV / raw: samples are little-endian on disk and in memory on the Pi
+    const uint64_t frame_bytes = (uint64_t)sample_format_bytes(src->sample) * (uint64_t)src->channels;
+    uint64_t want = (uint64_t)max_frames * frame_bytes;
+    if (want > src->data_left) want = src->data_left - src->data_left % frame_bytes;
+    size_t got = fread(dst, 1, (size_t)want, src->fp);
+    if (got == 0 && ferror(src->fp)) return -1;
+    if (src->data_left != UINT64_MAX) src->data_left -= got;
+    return (int)(got / (size_t)frame_bytes);
+}
+
+void file_source_close(file_source_t *src) {
+    if (!src) return;
+    if (src->fp) fclose(src->fp);
+    if (src->packet) av_packet_free(&src->packet);
+    if (src->frame) av_frame_free(&src->frame);
+    if (src->codec_ctx) avcodec_free_context(&src->codec_ctx);
+    if (src->fmt_ctx) avformat_close_input(&src->fmt_ctx);
+    free(src->repacked);
+    memset(src, 0, sizeof(*src));
+    src->stream_index = -1;
+}
@@ -0,0 +1,56 @@
+#ifndef FILE_SOURCE_H
+#define FILE_SOURCE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "musicprocessor.h"
+#include "sample_convert.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest frame file_source_read() can return: 32-bit samples
+#define FILE_SOURCE_MAX_SAMPLE_BYTES 4
+
+typedef struct {
+    mp_file_format_t format;
+    sample_format_t sample;   // layout of the samples returned by the last file_source_read()
+    int sample_rate;
+    int channels;
+    FILE *fp;                 // WAV / raw
+    uint64_t data_left;       // WAV: bytes left in the data chunk
+
+    // FFMPEG: decoded frames are returned in their native layout when the
+    // pipeline converts it (s16/s32/f32, packed or planar), otherwise repacked to f32
+    struct AVFormatContext *fmt_ctx;
+    struct AVCodecContext *codec_ctx;
+    struct AVPacket *packet;
+    struct AVFrame *frame;
+    int stream_index;
+    float *repacked;          // f32 copy of frames in other formats
+    int repacked_capacity;    // in frames
+    int pending_frames;       // frames in the current decoded frame
+    int pending_pos;          // frames already returned from it
+    int eof;
+} file_source_t;
+
+// Open a replay file. sample_rate/channels describe raw files and are
+// ignored for self-describing formats. Returns 0 on success.
+int file_source_open(file_source_t *src, const char *path, mp_file_format_t format,
+                     int sample_rate, int channels);
+
+// Read up to max_frames frames into dst, which must hold
+// max_frames * channels * FILE_SOURCE_MAX_SAMPLE_BYTES bytes. The data is in
+// src->sample layout (planar: planes back to back, one per channel, each as
+// long as the returned frame count).
+// Returns frames read, 0 at end of file, negative on error.
+int file_source_read(file_source_t *src, void *dst, int max_frames);
+
+void file_source_close(file_source_t *src);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FILE_SOURCE_H
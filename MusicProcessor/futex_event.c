@@ -0,0 +1,52 @@
+#include "futex_event.h"
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+static uint64_t futex_event_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void futex_event_init(futex_event_t *ev) {
+    __atomic_store_n(&ev->seq, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ev->waiters, 0, __ATOMIC_SEQ_CST);
+}
+
+uint32_t futex_event_snapshot(futex_event_t *ev) {
+    return __atomic_load_n(&ev->seq, __ATOMIC_SEQ_CST);
+}
+
+void futex_event_signal(futex_event_t *ev) {
+    __atomic_add_fetch(&ev->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ev->waiters, __ATOMIC_SEQ_CST) > 0) {
+        syscall(SYS_futex, &ev->seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+bool futex_event_wait(futex_event_t *ev, uint32_t seen, int timeout_ms) {
+    uint64_t deadline_ns = futex_event_now_ns() + (uint64_t)(timeout_ms < 0 ? 0 : timeout_ms) * 1000000ull;
+
+    // A signal between snapshot and FUTEX_WAIT changes seq, so the kernel
+    // returns immediately instead of losing the wake-up
+    while (__atomic_load_n(&ev->seq, __ATOMIC_SEQ_CST) == seen) {
+        struct timespec rel;
+        struct timespec *rel_ptr = NULL;
+        if (timeout_ms >= 0) {
+            uint64_t now_ns = futex_event_now_ns();
+            if (now_ns >= deadline_ns) return false;
+            uint64_t left_ns = deadline_ns - now_ns;
+            rel.tv_sec = (time_t)(left_ns / 1000000000ull);
+            rel.tv_nsec = (long)(left_ns % 1000000000ull);
+            rel_ptr = &rel;
+        }
+
+        __atomic_add_fetch(&ev->waiters, 1, __ATOMIC_SEQ_CST);
+        syscall(SYS_futex, &ev->seq, FUTEX_WAIT_PRIVATE, seen, rel_ptr, NULL, 0);
+        __atomic_sub_fetch(&ev->waiters, 1, __ATOMIC_SEQ_CST);
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef FUTEX_EVENT_H
+#define FUTEX_EVENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lightweight "something changed" notification built on a Linux futex.
+// Signalling is lock-free and skips the syscall when nobody is waiting.
+// Usage: seen = futex_event_snapshot(ev); check condition; futex_event_wait(ev, seen, ...)
+typedef struct {
+    uint32_t seq;       // bumped on every signal
+    uint32_t waiters;   // threads currently sleeping in futex_event_wait()
+} futex_event_t;
+
+void futex_event_init(futex_event_t *ev);
+
+// Current event counter; take it BEFORE checking the condition you wait for
+uint32_t futex_event_snapshot(futex_event_t *ev);
+
+// Wake every waiter (safe to call from any thread)
+void futex_event_signal(futex_event_t *ev);
+
+// Sleep until the event is signalled after `seen` was taken or the timeout expires.
+// timeout_ms < 0 waits forever. Returns true if the event was signalled.
+bool futex_event_wait(futex_event_t *ev, uint32_t seen, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FUTEX_EVENT_H
@@ -1,9 +1,14 @@
+#define _GNU_SOURCE   // pthread_setaffinity_np, CPU_SET
+
 #include "musicprocessor.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
+#include <time.h>
+#include <stddef.h>
+#include <sched.h>
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libavdevice/avdevice.h>
@@ -14,20 +19,149 @@
 #include "kissfft/kiss_fft.h"
 #include "kissfft/kiss_fftr.h"
 #include "ring_buffer.h"
+#include "dsp.h"
+#include "futex_event.h"
+#include "spsc_queue.h"
+#include "alsa_capture.h"
+#include "file_source.h"
+#include "sample_convert.h"
+#include "band_mapper.h"
+#include "profiler.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(59, 24, 100)
+#define MP_AV_CHANNELS(x) ((x)->ch_layout.nb_channels)
+#else
+#define MP_AV_CHANNELS(x) ((x)->channels)
+#endif
+
+// Ring buffer capacity in FFT windows: headroom for the producer to run ahead
+// of the analysis before samples are dropped
+#define MP_RING_WINDOWS 4
+
+// Number of spectrum frame slots. One slot holds the latest frame, one is being
+// written, the rest can stay pinned by consumers (UI thread, LED thread).
+#define MP_FRAME_SLOTS 4
+
+// Pipeline pools: raw packet chunks between capture and convert, spectra
+// between FFT and reduce. Capture never waits; with no free chunk it drops.
+#define MP_CHUNK_COUNT 16
+#define MP_CHUNK_CAPACITY 16384      // bytes, grown on demand for larger packets
+#define MP_SPECTRUM_COUNT 4
+#define MP_STAGE_WAIT_MS 100         // idle wake-up so stage threads notice a stop
+
+// Frequency range of the visualizer bands (features and mp_get_bands())
+#define MP_BANDS_MIN_HZ 60.0f
+#define MP_BANDS_MAX_HZ 8000.0f
+
+// MP_SOURCE_IMPULSE: length and level of one click (a short full-band burst)
+#define MP_IMPULSE_SAMPLES 32
+#define MP_IMPULSE_LEVEL 0.9f
+
+// Scope trigger: the signal must go below -MP_SCOPE_HYSTERESIS before a rising
+// zero crossing counts, so noise around zero does not retrigger
+#define MP_SCOPE_HYSTERESIS 0.02f
+
+// Raw samples copied out of the capture device by the capture stage
+typedef struct {
+    uint8_t* data;
+    int size;
+    int capacity;
+    sample_format_t format;
+    int channels;
+    uint64_t capture_ns;     // capture time of the last frame
+} mp_chunk_t;
+
+// Complex spectrum handed from the FFT stage to the reduce stage
+typedef struct {
+    kiss_fft_cpx* bins;
+    float rms;               // RMS of the window's newest hop
+    float* scope;            // config.scope_length trigger-aligned samples
+    int scope_triggered;
+    uint64_t capture_ns;
+} mp_spectrum_t;
+
+// Frame slot: the public frame must stay the first member (see mp_release_frame)
+typedef struct {
+    mp_frame_t frame;
+    float* magnitude;
+    float* magnitude_sum;    // bins + 1 prefix sums
+    float* bands;            // config.feature_bands
+    float* scope_samples;    // config.scope_length
+    float* scope_min;        // decimation pyramid, all levels back to back
+    float* scope_max;
+    uint32_t readers;        // number of consumers currently holding this slot
+} mp_frame_slot_t;
 
 // Internal data structure
 typedef struct {
     kiss_fftr_cfg fft_cfg;
     ring_buffer_t* ring_buffer;
     float* input_buffer;
-    kiss_fft_cpx* output_buffer;
-    float* magnitude;
+    float* window;           // window coefficients (NULL for rectangular)
     mp_state_t state;
     mp_config_t config;
+
+    // Pipeline: capture -> [raw_queue] -> convert -> ring_buffer -> FFT -> [spectrum_queue] -> reduce/publish.
+    // Every queue is SPSC; buffers travel back to their producer through a free queue.
+    mp_chunk_t chunks[MP_CHUNK_COUNT];
+    spsc_queue_t chunk_free;
+    mp_chunk_t* capture_chunk;    // chunk taken by capture but not filled yet
+    spsc_queue_t raw_queue;
+    mp_spectrum_t spectra[MP_SPECTRUM_COUNT];
+    spsc_queue_t spectrum_free;
+    mp_spectrum_t* fft_spectrum;  // buffer held by the FFT stage between windows
+    spsc_queue_t spectrum_queue;
+    futex_event_t ring_event;     // signalled by convert after each ring write
+    futex_event_t space_event;    // signalled by FFT after each window release
+    bool lossless;                // back-pressure instead of drops (fast file replay)
+    int fft_busy;                 // FFT stage holds an acquired window (lossless drain)
+    uint64_t spectra_queued;      // spectra pushed by FFT (lossless drain)
+    uint64_t spectra_reduced;     // spectra published by reduce (lossless drain)
+    pthread_t stage_threads[MP_STAGE_COUNT];
+    int stages_running;
+    uint64_t chunks_dropped;      // packets skipped by capture (convert fell behind)
+
+    // Timestamp anchor: capture time of the sample at ring write_count (seqlock)
+    uint32_t anchor_seq;
+    uint64_t anchor_count;
+    uint64_t anchor_ns;
+
+    // Spectrum frame publication (written only by the processing thread)
+    mp_frame_slot_t slots[MP_FRAME_SLOTS];
+    int latest_slot;         // index of the latest published slot, -1 if none
+    uint64_t frame_seq;      // sequence number of the latest published frame
+    uint64_t frames_dropped; // frames skipped: every other slot pinned / window overwritten
+    futex_event_t frame_event; // signalled on every publish, waited on by mp_wait_frame()
     
+    // Feature reduction (reduce stage only)
+    band_mapper_t feature32;
+    band_mapper_t feature64;
+    band_mapper_t feature_n;
+    int bass_end, mid_end, treble_end; // bin limits of bass/mid/treble
+    int features_rate;                 // sample rate the tables above were built for
+
+    // Time-domain history of the FFT stage for the scope snapshot: the newest
+    // hop of every validated window is appended, the trigger is searched in it
+    float* scope_history;
+    int scope_history_len;
+    int scope_history_cap;
+
     // FFmpeg related
     AVFormatContext* input_fmt_ctx;
     int audio_stream_index;
+    sample_format_t input_format; // layout of the demuxed packets
+    int input_channels;
+
+    // Native ALSA (MP_SOURCE_ALSA_MMAP)
+    alsa_capture_t alsa;
+
+    // File replay (MP_SOURCE_FILE)
+    file_source_t file;
+    double replay_fps;
 } mp_processor_t;
 
 // Global processor instance
@@ -35,8 +169,38 @@ static mp_processor_t g_processor = {0};
 static int g_initialized = 0;
 
 // Internal function declarations
-static void process_fft(void);
-static void convert_samples_to_float(AVPacket* packet, float* output, int* num_samples);
+static float* build_window(mp_window_t type, int size);
+static int pipeline_init(void);
+static void pipeline_free(void);
+static int pipeline_start(void);
+static void pipeline_stop(void);
+static void stage_set_affinity(pthread_t thread, mp_stage_t stage);
+static void capture_ffmpeg(void);
+static void capture_alsa(void);
+static void capture_file(void);
+static void capture_impulse(void);
+static void pipeline_drain(void);
+static mp_chunk_t* capture_take_chunk(void);
+static void capture_packet(const AVPacket* packet, uint64_t capture_ns);
+static uint64_t packet_capture_ns(const AVPacket* packet, uint64_t now_ns);
+static void* convert_stage(void* arg);
+static void* fft_stage(void* arg);
+static void* reduce_stage(void* arg);
+static void anchor_store(uint64_t write_count, uint64_t capture_ns);
+static uint64_t anchor_timestamp(uint64_t sample_count);
+static int process_fft(const float* window_data, uint64_t window_end, kiss_fft_cpx* out, float* rms);
+static void reduce_spectrum(const mp_spectrum_t* spectrum);
+static int features_init(void);
+static void close_input(void);
+static void scope_write_hop(const float* window_data);
+static void scope_commit_hop(void);
+static void scope_snapshot(mp_spectrum_t* spectrum);
+static void scope_publish(mp_frame_slot_t* slot, const mp_spectrum_t* spectrum);
+static int hz_to_bin(float hz);
+static mp_frame_slot_t* frame_begin_write(void);
+static void frame_publish(mp_frame_slot_t* slot, uint64_t capture_ns);
+static uint64_t mp_now_ns(void);
+static void convert_chunk(const mp_chunk_t* chunk);
 static int setup_audio_input(void);
 static void display_spectrum(void);
 
@@ -46,7 +210,20 @@ mp_config_t mp_get_default_config(void) {
         .sample_rate = MP_SAMPLE_RATE,
         .channels = 1,
         .fft_size = MP_FFT_SIZE,
-        .device_name = "default"
+        .hop_size = MP_HOP_SIZE,
+        .window = MP_WINDOW_HANN,
+        .device_name = "default",
+        .source = MP_SOURCE_FFMPEG_ALSA,
+        .period_frames = MP_PERIOD_FRAMES,
+        .buffer_frames = MP_ALSA_BUFFER_FRAMES,
+        .file_format = MP_FILE_AUTO,
+        .pacing = MP_PACING_REALTIME,
+        .analysis_channel = -1,
+        .feature_bands = MP_FEATURE_BANDS,
+        .stage_cpu = {-1, -1, -1, -1},
+        .scope_length = MP_SCOPE_LENGTH,
+        .scope_trigger = MP_SCOPE_TRIGGER_ZERO_CROSSING,
+        .impulse_interval_ms = MP_IMPULSE_INTERVAL_MS
     };
     return config;
 }
@@ -69,6 +246,9 @@ mp_result_t mp_init_with_config(const mp_config_t* config) {
     
     // Copy configuration
     g_processor.config = *config;
+    if (g_processor.config.hop_size <= 0 || g_processor.config.hop_size > config->fft_size) {
+        g_processor.config.hop_size = config->fft_size;
+    }
     
     // Initialize FFT
     g_processor.fft_cfg = kiss_fftr_alloc(config->fft_size, 0, NULL, NULL);
@@ -79,11 +259,52 @@ mp_result_t mp_init_with_config(const mp_config_t* config) {
     
     // Allocate buffers
     g_processor.input_buffer = (float*)calloc(config->fft_size, sizeof(float));
-    g_processor.output_buffer = (kiss_fft_cpx*)calloc(config->fft_size/2 + 1, sizeof(kiss_fft_cpx));
-    g_processor.magnitude = (float*)calloc(config->fft_size/2 + 1, sizeof(float));
-    
-    if (!g_processor.input_buffer || !g_processor.output_buffer || 
-        !g_processor.magnitude) {
+    g_processor.window = build_window(config->window, config->fft_size);
+
+    if (g_processor.config.feature_bands < 0) g_processor.config.feature_bands = 0;
+    if (g_processor.config.scope_length < 0) g_processor.config.scope_length = 0;
+    const int bins = config->fft_size/2 + 1;
+    const int feature_bands = g_processor.config.feature_bands;
+    const int scope_length = g_processor.config.scope_length;
+
+    int slots_ok = 1;
+    for (int i = 0; i < MP_FRAME_SLOTS; i++) {
+        mp_frame_slot_t* slot = &g_processor.slots[i];
+        slot->magnitude = (float*)calloc(bins, sizeof(float));
+        slot->magnitude_sum = (float*)calloc(bins + 1, sizeof(float));
+        slot->bands = (float*)calloc(feature_bands > 0 ? feature_bands : 1, sizeof(float));
+        slot->scope_samples = (float*)calloc(scope_length > 0 ? scope_length : 1, sizeof(float));
+        slot->scope_min = (float*)calloc(scope_length > 0 ? scope_length : 1, sizeof(float));
+        slot->scope_max = (float*)calloc(scope_length > 0 ? scope_length : 1, sizeof(float));
+        slot->readers = 0;
+        memset(&slot->frame, 0, sizeof(slot->frame));
+        slot->frame.bins = bins;
+        slot->frame.magnitude = slot->magnitude;
+        slot->frame.features.magnitude_sum = slot->magnitude_sum;
+        slot->frame.features.bands = slot->bands;
+        slot->frame.features.bands_count = feature_bands;
+        slot->frame.scope.length = scope_length;
+        slot->frame.scope.samples = slot->scope_samples;
+        if (!slot->magnitude || !slot->magnitude_sum || !slot->bands ||
+            !slot->scope_samples || !slot->scope_min || !slot->scope_max) slots_ok = 0;
+    }
+
+    // Two snapshots of history to search the trigger in, plus room to append
+    // hops before the history is compacted
+    g_processor.scope_history_cap = scope_length * 4 + g_processor.config.hop_size;
+    g_processor.scope_history_len = scope_length * 2;
+    g_processor.scope_history = (float*)calloc(g_processor.scope_history_cap, sizeof(float));
+    if (!g_processor.scope_history) slots_ok = 0;
+    g_processor.latest_slot = -1;
+    g_processor.frame_seq = 0;
+    g_processor.frames_dropped = 0;
+    futex_event_init(&g_processor.frame_event);
+    g_initialized = 1; // let mp_deinit() release partial allocations
+
+    int bands_ok = features_init() == 0;
+
+    if (!g_processor.input_buffer || !slots_ok || !bands_ok || pipeline_init() != 0 ||
+        (config->window != MP_WINDOW_RECTANGULAR && !g_processor.window)) {
         fprintf(stderr, "Unable to allocate memory for FFT\n");
         mp_deinit();
         return MP_ERROR_INIT;
@@ -96,13 +317,19 @@ mp_result_t mp_init_with_config(const mp_config_t* config) {
     // Initialize FFmpeg
     avdevice_register_all();
 
-    g_processor.ring_buffer = malloc(sizeof(ring_buffer_t));
-    bool check = ring_buffer_init(g_processor.ring_buffer, config->fft_size); 
-    printf("Ring buffer init check: %d\n", check);
+    g_processor.ring_buffer = calloc(1, sizeof(ring_buffer_t));
+    // Mirrored mode: the FFT window is always contiguous and can be read in place.
+    // Extra capacity lets the writer run ahead of the analysis (SPSC counters).
+    if (!g_processor.ring_buffer ||
+        !ring_buffer_init_mirrored(g_processor.ring_buffer, (size_t)config->fft_size * MP_RING_WINDOWS)) {
+        fprintf(stderr, "Unable to allocate memory for the ring buffer\n");
+        mp_deinit();
+        return MP_ERROR_INIT;
+    }
     
     g_initialized = 1;
-    printf("Music Processor initialized successfully (FFT_SIZE: %d)\n", 
-           config->fft_size);
+    printf("Music Processor initialized successfully (FFT_SIZE: %d, HOP_SIZE: %d)\n", 
+           config->fft_size, g_processor.config.hop_size);
     
     return MP_SUCCESS;
 }
@@ -118,10 +345,48 @@ mp_result_t mp_start_recording(void) {
     }
     
     // Setup audio input
-    if (setup_audio_input() != 0) {
+    if (g_processor.config.source == MP_SOURCE_FILE) {
+        if (file_source_open(&g_processor.file, g_processor.config.device_name, g_processor.config.file_format,
+                             g_processor.config.sample_rate, g_processor.config.channels) != 0) {
+            return MP_ERROR_DEVICE;
+        }
+        if (g_processor.file.sample_rate != g_processor.config.sample_rate) {
+            // Bin frequencies and timestamps follow the file
+            printf("File sample rate %d Hz overrides the configured %d Hz\n",
+                   g_processor.file.sample_rate, g_processor.config.sample_rate);
+            g_processor.config.sample_rate = g_processor.file.sample_rate;
+        }
+        g_processor.lossless = (g_processor.config.pacing == MP_PACING_FAST);
+        g_processor.replay_fps = 0.0;
+    } else if (g_processor.config.source == MP_SOURCE_IMPULSE) {
+        if (g_processor.config.impulse_interval_ms <= 0) {
+            g_processor.config.impulse_interval_ms = MP_IMPULSE_INTERVAL_MS;
+        }
+        printf("Synthetic impulse input: one click every %d ms\n", g_processor.config.impulse_interval_ms);
+    } else if (g_processor.config.source == MP_SOURCE_ALSA_MMAP) {
+        if (alsa_capture_open(&g_processor.alsa, g_processor.config.device_name,
+                              g_processor.config.sample_rate, g_processor.config.channels,
+                              g_processor.config.period_frames, g_processor.config.buffer_frames) != 0) {
+            return MP_ERROR_DEVICE;
+        }
+        if (g_processor.alsa.sample_rate != g_processor.config.sample_rate) {
+            // set_rate_near() may pick another rate: bins and timestamps follow the device
+            printf("ALSA sample rate %d Hz overrides the configured %d Hz\n",
+                   g_processor.alsa.sample_rate, g_processor.config.sample_rate);
+            g_processor.config.sample_rate = g_processor.alsa.sample_rate;
+        }
+    } else if (setup_audio_input() != 0) {
         return MP_ERROR_DEVICE;
     }
 
+    // Band edges and bass/mid/treble limits follow the final capture rate;
+    // the pipeline stages are not running yet
+    if (g_processor.features_rate != g_processor.config.sample_rate && features_init() != 0) {
+        fprintf(stderr, "Unable to build band tables for %d Hz\n", g_processor.config.sample_rate);
+        close_input();
+        return MP_ERROR_INIT;
+    }
+
     g_processor.state = MP_STATE_RECORDING;
     
     printf("Music processor started recording\n");
@@ -135,14 +400,18 @@ mp_result_t mp_stop_recording(void) {
     }
 
     g_processor.state = MP_STATE_IDLE;
+    close_input();
+    
+    printf("Music processor stopped recording\n");
+    return MP_SUCCESS;
+}
 
-    // Close input
+static void close_input(void) {
     if (g_processor.input_fmt_ctx) {
         avformat_close_input(&g_processor.input_fmt_ctx);
     }
-    
-    printf("Music processor stopped recording\n");
-    return MP_SUCCESS;
+    alsa_capture_close(&g_processor.alsa);
+    file_source_close(&g_processor.file);
 }
 
 // Cleanup
@@ -161,13 +430,37 @@ void mp_deinit(void) {
     }
     
     free(g_processor.input_buffer);
-    free(g_processor.output_buffer);
-    free(g_processor.magnitude);
+    free(g_processor.window);
+    pipeline_free();
+    band_mapper_free(&g_processor.feature32);
+    band_mapper_free(&g_processor.feature64);
+    band_mapper_free(&g_processor.feature_n);
+
+    __atomic_store_n(&g_processor.latest_slot, -1, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < MP_FRAME_SLOTS; i++) {
+        free(g_processor.slots[i].magnitude);
+        free(g_processor.slots[i].magnitude_sum);
+        free(g_processor.slots[i].bands);
+        free(g_processor.slots[i].scope_samples);
+        free(g_processor.slots[i].scope_min);
+        free(g_processor.slots[i].scope_max);
+        g_processor.slots[i].magnitude = NULL;
+        g_processor.slots[i].magnitude_sum = NULL;
+        g_processor.slots[i].bands = NULL;
+        g_processor.slots[i].scope_samples = NULL;
+        g_processor.slots[i].scope_min = NULL;
+        g_processor.slots[i].scope_max = NULL;
+        g_processor.slots[i].frame.magnitude = NULL;
+    }
+
+    free(g_processor.scope_history);
+    g_processor.scope_history = NULL;
 
     ring_buffer_free(g_processor.ring_buffer);
+    free(g_processor.ring_buffer);
+    g_processor.ring_buffer = NULL;
     g_processor.input_buffer = NULL;
-    g_processor.output_buffer = NULL;
-    g_processor.magnitude = NULL;
+    g_processor.window = NULL;
 
     g_initialized = 0;
     printf("Music processor deinitialized\n");
@@ -224,16 +517,58 @@ static int setup_audio_input(void) {
         return -1;
     }
     
+    // Sample layout of the packets: raw PCM demuxers describe it by codec id
+    AVCodecParameters* par = g_processor.input_fmt_ctx->streams[g_processor.audio_stream_index]->codecpar;
+    switch (par->codec_id) {
+        case AV_CODEC_ID_PCM_S16LE: g_processor.input_format = SAMPLE_FORMAT_S16; break;
+        case AV_CODEC_ID_PCM_S32LE: g_processor.input_format = SAMPLE_FORMAT_S32; break;
+        case AV_CODEC_ID_PCM_F32LE: g_processor.input_format = SAMPLE_FORMAT_F32; break;
+        default:                    g_processor.input_format = sample_format_from_av(par->format); break;
+    }
+    g_processor.input_channels = MP_AV_CHANNELS(par);
+    if (g_processor.input_channels <= 0) g_processor.input_channels = g_processor.config.channels;
+    if (g_processor.input_format == SAMPLE_FORMAT_UNKNOWN) {
+        fprintf(stderr, "Unsupported capture sample format\n");
+        av_dict_free(&options);
+        return -1;
+    }
+    printf("Capture stream: %d channel(s), %d-bit%s\n", g_processor.input_channels,
+           sample_format_bytes(g_processor.input_format) * 8,
+           sample_format_is_planar(g_processor.input_format) ? " planar" : "");
+    
     av_dict_free(&options);
     return 0;
 }
 
+// Capture stage: runs in the caller's thread and only copies samples out of
+// the device; conversion, FFT and band reduction run in their own stage threads
 void processing_function(void) {
+    stage_set_affinity(pthread_self(), MP_STAGE_CAPTURE);
+    if (pipeline_start() != 0) {
+        fprintf(stderr, "Cannot start processing pipeline\n");
+        return;
+    }
+
+    if (g_processor.config.source == MP_SOURCE_FILE) {
+        capture_file();
+    } else if (g_processor.config.source == MP_SOURCE_IMPULSE) {
+        capture_impulse();
+    } else if (g_processor.config.source == MP_SOURCE_ALSA_MMAP) {
+        capture_alsa();
+    } else {
+        capture_ffmpeg();
+    }
+
+    pipeline_stop();
+}
+
+static void capture_ffmpeg(void) {
     AVPacket packet;
-    float audio_samples[MP_BUFFER_SIZE];
-    
+
     while (g_processor.state == MP_STATE_RECORDING) {
+        uint64_t prof_start = prof_begin();
         int ret = av_read_frame(g_processor.input_fmt_ctx, &packet);
+        prof_end(PROF_STAGE_CAPTURE, prof_start);
         if (ret < 0) {
             if (ret == AVERROR(EAGAIN)) {
                 continue;
@@ -243,72 +578,810 @@ void processing_function(void) {
         }
         
         if (packet.stream_index == g_processor.audio_stream_index) {
-            int num_samples;
-            convert_samples_to_float(&packet, audio_samples, &num_samples);
-            int count_debug = ring_buffer_write(g_processor.ring_buffer, audio_samples, num_samples);
-            //printf("Wrote %f samples to ring buffer\n", g_processor.ring_buffer->buffer[g_processor.ring_buffer->current]);
-            process_fft();
+            capture_packet(&packet, packet_capture_ns(&packet, mp_now_ns()));
         }
         
         av_packet_unref(&packet);
     }
 }
 
-static void process_fft(void) {
-    
+// Native ALSA: each period is copied from the mmap area straight into a chunk
+static void capture_alsa(void) {
+    alsa_capture_t* cap = &g_processor.alsa;
+    const int frame_bytes = cap->channels * (int)sizeof(int16_t);
+    int16_t discard[MP_CHUNK_CAPACITY / sizeof(int16_t)];
+
+    while (g_processor.state == MP_STATE_RECORDING) {
+        mp_chunk_t* chunk = capture_take_chunk();
+
+        // Keep draining the device even when convert is behind, otherwise ALSA overruns
+        int16_t* dst = chunk ? (int16_t*)chunk->data : discard;
+        int max_frames = (chunk ? chunk->capacity : (int)sizeof(discard)) / frame_bytes;
+        uint64_t prof_start = prof_begin();
+        int frames = alsa_capture_read(cap, dst, max_frames, MP_STAGE_WAIT_MS);
+        prof_end(PROF_STAGE_CAPTURE, prof_start);
+        // Driver timestamp of the newest frame read when available (htimestamp)
+        uint64_t capture_ns = cap->capture_ns ? cap->capture_ns : mp_now_ns();
+        if (frames < 0) {
+            fprintf(stderr, "ALSA capture error\n");
+            break;
+        }
+
+        if (!chunk) {
+            if (frames > 0) __atomic_add_fetch(&g_processor.chunks_dropped, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (frames == 0) continue;   // chunk stays in capture_chunk for the next read
+
+        g_processor.capture_chunk = NULL;
+        chunk->size = frames * frame_bytes;
+        chunk->format = SAMPLE_FORMAT_S16;
+        chunk->channels = cap->channels;
+        chunk->capture_ns = capture_ns;
+        spsc_queue_push(&g_processor.raw_queue, chunk);
+    }
+}
+
+// Build periodic window coefficients, normalized to unit coherent gain so a
+// windowed sine keeps the same peak magnitude as with the rectangular window
+static float* build_window(mp_window_t type, int size) {
+    if (type == MP_WINDOW_RECTANGULAR || size <= 0) {
+        return NULL;
+    }
+
+    // Cosine-sum coefficients: w[n] = a0 - a1*cos(x) + a2*cos(2x) - a3*cos(3x) + a4*cos(4x)
+    double a[5] = {0};
+    switch (type) {
+        case MP_WINDOW_HANN:            a[0] = 0.5;     a[1] = 0.5;     break;
+        case MP_WINDOW_HAMMING:         a[0] = 0.54;    a[1] = 0.46;    break;
+        case MP_WINDOW_BLACKMAN_HARRIS: a[0] = 0.35875; a[1] = 0.48829; a[2] = 0.14128; a[3] = 0.01168; break;
+        case MP_WINDOW_FLAT_TOP:
+            a[0] = 0.21557895; a[1] = 0.41663158; a[2] = 0.277263158; a[3] = 0.083578947; a[4] = 0.006947368;
+            break;
+        default:
+            return NULL;
+    }
+
+    float* window = (float*)malloc((size_t)size * sizeof(float));
+    if (!window) return NULL;
+
+    double sum = 0.0;
+    for (int n = 0; n < size; n++) {
+        double x = 2.0 * M_PI * (double)n / (double)size;
+        double w = a[0] - a[1] * cos(x) + a[2] * cos(2.0 * x) - a[3] * cos(3.0 * x) + a[4] * cos(4.0 * x);
+        window[n] = (float)w;
+        sum += w;
+    }
+
+    float gain = (sum > 0.0) ? (float)((double)size / sum) : 1.0f;
+    for (int n = 0; n < size; n++) {
+        window[n] *= gain;
+    }
+    return window;
+}
+
+static int pipeline_init(void) {
+    const int bins = g_processor.config.fft_size/2 + 1;
+    const int scope_length = g_processor.config.scope_length;
+
+    if (!spsc_queue_init(&g_processor.chunk_free, MP_CHUNK_COUNT) ||
+        !spsc_queue_init(&g_processor.raw_queue, MP_CHUNK_COUNT) ||
+        !spsc_queue_init(&g_processor.spectrum_free, MP_SPECTRUM_COUNT) ||
+        !spsc_queue_init(&g_processor.spectrum_queue, MP_SPECTRUM_COUNT)) {
+        return -1;
+    }
+
+    for (int i = 0; i < MP_CHUNK_COUNT; i++) {
+        mp_chunk_t* chunk = &g_processor.chunks[i];
+        chunk->data = (uint8_t*)malloc(MP_CHUNK_CAPACITY);
+        chunk->capacity = chunk->data ? MP_CHUNK_CAPACITY : 0;
+        chunk->size = 0;
+        if (!chunk->data) return -1;
+        spsc_queue_push(&g_processor.chunk_free, chunk);
+    }
+    for (int i = 0; i < MP_SPECTRUM_COUNT; i++) {
+        mp_spectrum_t* spectrum = &g_processor.spectra[i];
+        spectrum->bins = (kiss_fft_cpx*)calloc(bins, sizeof(kiss_fft_cpx));
+        spectrum->scope = (float*)calloc(scope_length > 0 ? scope_length : 1, sizeof(float));
+        spectrum->scope_triggered = 0;
+        if (!spectrum->bins || !spectrum->scope) return -1;
+        spsc_queue_push(&g_processor.spectrum_free, spectrum);
+    }
+
+    futex_event_init(&g_processor.ring_event);
+    futex_event_init(&g_processor.space_event);
+    g_processor.lossless = false;
+    g_processor.fft_busy = 0;
+    g_processor.spectra_queued = 0;
+    g_processor.spectra_reduced = 0;
+    g_processor.capture_chunk = NULL;
+    g_processor.fft_spectrum = NULL;
+    g_processor.stages_running = 0;
+    g_processor.chunks_dropped = 0;
+    g_processor.anchor_seq = 0;
+    g_processor.anchor_count = 0;
+    g_processor.anchor_ns = 0;
+    return 0;
+}
+
+static void pipeline_free(void) {
+    for (int i = 0; i < MP_CHUNK_COUNT; i++) {
+        free(g_processor.chunks[i].data);
+        g_processor.chunks[i].data = NULL;
+        g_processor.chunks[i].capacity = 0;
+    }
+    for (int i = 0; i < MP_SPECTRUM_COUNT; i++) {
+        free(g_processor.spectra[i].bins);
+        free(g_processor.spectra[i].scope);
+        g_processor.spectra[i].bins = NULL;
+        g_processor.spectra[i].scope = NULL;
+    }
+    spsc_queue_free(&g_processor.chunk_free);
+    spsc_queue_free(&g_processor.raw_queue);
+    spsc_queue_free(&g_processor.spectrum_free);
+    spsc_queue_free(&g_processor.spectrum_queue);
+}
+
+static int pipeline_start(void) {
+    void* (*entry[MP_STAGE_COUNT])(void*) = { NULL, convert_stage, fft_stage, reduce_stage };
+
+    __atomic_store_n(&g_processor.stages_running, 1, __ATOMIC_SEQ_CST);
+    for (int s = MP_STAGE_CONVERT; s < MP_STAGE_COUNT; s++) {
+        if (pthread_create(&g_processor.stage_threads[s], NULL, entry[s], NULL) != 0) {
+            // Unwind the stages that did start
+            __atomic_store_n(&g_processor.stages_running, 0, __ATOMIC_SEQ_CST);
+            spsc_queue_wake(&g_processor.raw_queue);
+            futex_event_signal(&g_processor.ring_event);
+            spsc_queue_wake(&g_processor.spectrum_queue);
+            for (int j = MP_STAGE_CONVERT; j < s; j++) {
+                pthread_join(g_processor.stage_threads[j], NULL);
+            }
+            return -1;
+        }
+        stage_set_affinity(g_processor.stage_threads[s], (mp_stage_t)s);
+    }
+    return 0;
+}
+
+static void pipeline_stop(void) {
+    __atomic_store_n(&g_processor.stages_running, 0, __ATOMIC_SEQ_CST);
+    spsc_queue_wake(&g_processor.raw_queue);
+    futex_event_signal(&g_processor.ring_event);
+    futex_event_signal(&g_processor.space_event);
+    spsc_queue_wake(&g_processor.spectrum_free);
+    spsc_queue_wake(&g_processor.spectrum_queue);
+    for (int s = MP_STAGE_CONVERT; s < MP_STAGE_COUNT; s++) {
+        pthread_join(g_processor.stage_threads[s], NULL);
+    }
+}
+
+static void stage_set_affinity(pthread_t thread, mp_stage_t stage) {
+    int cpu = g_processor.config.stage_cpu[stage];
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0) {
+        fprintf(stderr, "Cannot pin pipeline stage %d to CPU %d\n", (int)stage, cpu);
+    }
+}
+
+static bool stages_running(void) {
+    return __atomic_load_n(&g_processor.stages_running, __ATOMIC_SEQ_CST) != 0;
+}
+
+// File replay: period-sized chunks, paced in real time or pushed as fast as the
+// pipeline takes them (lossless, the stages wait instead of dropping)
+static void capture_file(void) {
+    file_source_t* src = &g_processor.file;
+    const int period = g_processor.config.period_frames > 0 ? g_processor.config.period_frames : MP_PERIOD_FRAMES;
+    const uint64_t start_ns = mp_now_ns();
+    const uint64_t start_seq = mp_get_frame_seq();
+    uint64_t frames_total = 0;
+
+    uint8_t discard[MP_CHUNK_CAPACITY];
+
+    while (g_processor.state == MP_STATE_RECORDING) {
+        mp_chunk_t* chunk = capture_take_chunk();
+        if (!chunk && g_processor.lossless) {
+            void* item;
+            if (spsc_queue_pop_wait(&g_processor.chunk_free, &item, MP_STAGE_WAIT_MS)) {
+                g_processor.capture_chunk = (mp_chunk_t*)item;
+            }
+            continue;
+        }
+
+        // Real time behaves like a device: with no free chunk the period is lost
+        uint8_t* dst = chunk ? chunk->data : discard;
+        const int max_frame_bytes = src->channels * FILE_SOURCE_MAX_SAMPLE_BYTES;
+        int max_frames = (chunk ? chunk->capacity : (int)sizeof(discard)) / max_frame_bytes;
+        if (max_frames > period) max_frames = period;
+        uint64_t prof_start = prof_begin();
+        int frames = file_source_read(src, dst, max_frames);
+        prof_end(PROF_STAGE_CAPTURE, prof_start);
+        if (frames < 0) {
+            fprintf(stderr, "File read error\n");
+            break;
+        }
+        if (frames == 0) break;   // end of file
+
+        frames_total += (uint64_t)frames;
+        if (!g_processor.lossless) {
+            struct timespec due;
+            uint64_t due_ns = start_ns + frames_total * 1000000000ull / (uint64_t)src->sample_rate;
+            due.tv_sec = (time_t)(due_ns / 1000000000ull);
+            due.tv_nsec = (long)(due_ns % 1000000000ull);
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+        }
+
+        if (!chunk) {
+            __atomic_add_fetch(&g_processor.chunks_dropped, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        g_processor.capture_chunk = NULL;
+        chunk->size = frames * src->channels * sample_format_bytes(src->sample);
+        chunk->format = src->sample;
+        chunk->channels = src->channels;
+        chunk->capture_ns = mp_now_ns();
+        spsc_queue_push(&g_processor.raw_queue, chunk);
+    }
+
+    if (g_processor.lossless) {
+        pipeline_drain();
+        double seconds = (double)(mp_now_ns() - start_ns) / 1e9;
+        uint64_t frames = mp_get_frame_seq() - start_seq;
+        g_processor.replay_fps = seconds > 0.0 ? (double)frames / seconds : 0.0;
+        printf("File replay: %llu samples -> %llu frames in %.3f s (%.1f frames/s, %.1fx real time)\n",
+               (unsigned long long)frames_total, (unsigned long long)frames, seconds, g_processor.replay_fps,
+               seconds > 0.0 ? (double)frames_total / (double)src->sample_rate / seconds : 0.0);
+    }
+}
+
+// Synthetic input: silence with a click every impulse_interval_ms, produced one
+// period at a time at the real-time rate. A period is stamped with the time its
+// last sample is due, as if a microphone had just delivered it.
+static void capture_impulse(void) {
+    const int period = g_processor.config.period_frames > 0 ? g_processor.config.period_frames : MP_PERIOD_FRAMES;
+    const uint64_t rate = (uint64_t)g_processor.config.sample_rate;
+    const uint64_t interval = rate * (uint64_t)g_processor.config.impulse_interval_ms / 1000u;
+    const uint64_t start_ns = mp_now_ns();
+    uint64_t frames_total = 0;
+
+    while (g_processor.state == MP_STATE_RECORDING) {
+        uint64_t due_ns = start_ns + (frames_total + (uint64_t)period) * 1000000000ull / rate;
+        struct timespec due;
+        due.tv_sec = (time_t)(due_ns / 1000000000ull);
+        due.tv_nsec = (long)(due_ns % 1000000000ull);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+
+        mp_chunk_t* chunk = capture_take_chunk();
+        if (!chunk) {
+            __atomic_add_fetch(&g_processor.chunks_dropped, 1, __ATOMIC_RELAXED);
+            frames_total += (uint64_t)period;
+            continue;
+        }
+
+        const int bytes = period * (int)sizeof(float);
+        if (bytes > chunk->capacity) {
+            uint8_t* data = (uint8_t*)realloc(chunk->data, (size_t)bytes);
+            if (!data) {
+                __atomic_add_fetch(&g_processor.chunks_dropped, 1, __ATOMIC_RELAXED);
+                frames_total += (uint64_t)period;
+                continue;
+            }
+            chunk->data = data;
+            chunk->capacity = bytes;
+        }
+
+        uint64_t prof_start = prof_begin();
+        float* samples = (float*)chunk->data;
+        for (int i = 0; i < period; i++) {
+            uint64_t phase = interval ? (frames_total + (uint64_t)i) % interval : 1;
+            samples[i] = phase < MP_IMPULSE_SAMPLES ? MP_IMPULSE_LEVEL : 0.0f;
+        }
+        prof_end(PROF_STAGE_CAPTURE, prof_start);
+        frames_total += (uint64_t)period;
+
+        g_processor.capture_chunk = NULL;
+        chunk->size = bytes;
+        chunk->format = SAMPLE_FORMAT_F32;
+        chunk->channels = 1;
+        chunk->capture_ns = due_ns;
+        spsc_queue_push(&g_processor.raw_queue, chunk);
+    }
+}
+
+// Wait until every captured sample has gone through the pipeline. Checked
+// upstream first: each stage hands its work on before it looks idle.
+static bool pipeline_idle(void) {
+    const size_t hop = (size_t)g_processor.config.hop_size;
+    // Convert returns a chunk only after writing it to the ring buffer
+    int chunks = (int)spsc_queue_size(&g_processor.chunk_free) + (g_processor.capture_chunk ? 1 : 0);
+    if (chunks < MP_CHUNK_COUNT) return false;
+    // The FFT stage is busy from acquire until its spectrum is queued
+    if (ring_buffer_available(g_processor.ring_buffer) >= hop) return false;
+    if (__atomic_load_n(&g_processor.fft_busy, __ATOMIC_SEQ_CST)) return false;
+    uint64_t queued = __atomic_load_n(&g_processor.spectra_queued, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&g_processor.spectra_reduced, __ATOMIC_SEQ_CST) == queued;
+}
+
+static void pipeline_drain(void) {
+    while (!pipeline_idle() && stages_running()) {
+        usleep(1000);
+    }
+}
+
+// The capture thread only consumes chunk_free (SPSC), so a chunk it cannot
+// fill is parked in capture_chunk instead of being pushed back
+static mp_chunk_t* capture_take_chunk(void) {
+    if (!g_processor.capture_chunk) {
+        void* item;
+        if (spsc_queue_pop(&g_processor.chunk_free, &item)) {
+            g_processor.capture_chunk = (mp_chunk_t*)item;
+        }
+    }
+    return g_processor.capture_chunk;
+}
+
+// Capture: copy the packet into a free chunk and hand it to the convert stage.
+// Never blocks; if convert is behind and no chunk is free the packet is dropped.
+static void capture_packet(const AVPacket* packet, uint64_t capture_ns) {
+    mp_chunk_t* chunk = capture_take_chunk();
+    if (!chunk) {
+        __atomic_add_fetch(&g_processor.chunks_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    if (packet->size > chunk->capacity) {
+        uint8_t* data = (uint8_t*)realloc(chunk->data, (size_t)packet->size);
+        if (!data) {
+            __atomic_add_fetch(&g_processor.chunks_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        chunk->data = data;
+        chunk->capacity = packet->size;
+    }
+
+    g_processor.capture_chunk = NULL;
+    memcpy(chunk->data, packet->data, (size_t)packet->size);
+    chunk->size = packet->size;
+    chunk->format = g_processor.input_format;
+    chunk->channels = g_processor.input_channels;
+    chunk->capture_ns = capture_ns;
+    spsc_queue_push(&g_processor.raw_queue, chunk);  // cannot fail: MP_CHUNK_COUNT slots
+}
+
+// Capture time of the packet's last sample from its pts. The ALSA demuxer
+// stamps the first sample in wall-clock microseconds (av_gettime() minus the
+// device delay); map it to CLOCK_MONOTONIC. Falls back to now_ns.
+static uint64_t packet_capture_ns(const AVPacket* packet, uint64_t now_ns) {
+    if (packet->pts == AV_NOPTS_VALUE || sample_format_is_planar(g_processor.input_format)) return now_ns;
+
+    AVStream* stream = g_processor.input_fmt_ctx->streams[g_processor.audio_stream_index];
+    int64_t pts_us = av_rescale_q(packet->pts, stream->time_base, AV_TIME_BASE_Q);
+    int frame_bytes = sample_format_bytes(g_processor.input_format) * g_processor.input_channels;
+    if (frame_bytes > 0 && g_processor.config.sample_rate > 0) {
+        pts_us += (int64_t)(packet->size / frame_bytes) * 1000000 / g_processor.config.sample_rate;
+    }
+
+    int64_t age_us = av_gettime() - pts_us;
+    if (age_us < 0 || age_us > 1000000) return now_ns;   // not a wall-clock pts
+    return now_ns - (uint64_t)age_us * 1000u;
+}
+
+// Convert: raw chunk -> float samples -> ring buffer
+static void* convert_stage(void* arg) {
+    (void)arg;
+
+    while (stages_running()) {
+        void* item;
+        if (!spsc_queue_pop_wait(&g_processor.raw_queue, &item, MP_STAGE_WAIT_MS)) continue;
+
+        mp_chunk_t* chunk = (mp_chunk_t*)item;
+        uint64_t prof_start = prof_begin();
+        convert_chunk(chunk);
+        prof_end(PROF_STAGE_CONVERT, prof_start);
+        spsc_queue_push(&g_processor.chunk_free, chunk);
+    }
+    return NULL;
+}
+
+// FFT: one window per hop_size samples, independent of the packet size
+static void* fft_stage(void* arg) {
+    (void)arg;
+    ring_buffer_t* rb = g_processor.ring_buffer;
+    mp_spectrum_t* spectrum = g_processor.fft_spectrum;
+
+    while (stages_running()) {
+        uint32_t seen = futex_event_snapshot(&g_processor.ring_event);
+
+        uint64_t window_end;
+        const float* window_data = ring_buffer_acquire_window(rb, g_processor.config.hop_size,
+                                                              g_processor.config.fft_size, &window_end);
+        if (!window_data) {
+            futex_event_wait(&g_processor.ring_event, seen, MP_STAGE_WAIT_MS);
+            continue;
+        }
+        __atomic_store_n(&g_processor.fft_busy, 1, __ATOMIC_SEQ_CST);
+
+        // Scope history: copied now, kept only if the window release validates it
+        scope_write_hop(window_data);
+
+        // Reduce is behind: keep the hop cadence, skip this frame.
+        // Lossless replay waits for reduce instead, until the pipeline stops.
+        if (!spectrum) {
+            void* item;
+            bool got = spsc_queue_pop(&g_processor.spectrum_free, &item);
+            while (!got && g_processor.lossless && stages_running()) {
+                got = spsc_queue_pop_wait(&g_processor.spectrum_free, &item, MP_STAGE_WAIT_MS);
+            }
+            if (!got) {
+                if (ring_buffer_release_window(rb, window_end, (size_t)g_processor.config.fft_size)) {
+                    scope_commit_hop();
+                }
+                __atomic_add_fetch(&g_processor.frames_dropped, 1, __ATOMIC_RELAXED);
+                __atomic_store_n(&g_processor.fft_busy, 0, __ATOMIC_SEQ_CST);
+                continue;
+            }
+            spectrum = (mp_spectrum_t*)item;
+        }
+
+        uint64_t prof_start = prof_begin();
+        int fft_ret = process_fft(window_data, window_end, spectrum->bins, &spectrum->rms);
+        prof_end(PROF_STAGE_FFT, prof_start);
+        futex_event_signal(&g_processor.space_event);
+        if (fft_ret != 0) {
+            __atomic_add_fetch(&g_processor.frames_dropped, 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&g_processor.fft_busy, 0, __ATOMIC_SEQ_CST);
+            continue;   // keep the buffer for the next window
+        }
+
+        scope_commit_hop();
+        scope_snapshot(spectrum);
+        spectrum->capture_ns = anchor_timestamp(window_end);
+        __atomic_add_fetch(&g_processor.spectra_queued, 1, __ATOMIC_SEQ_CST);
+        spsc_queue_push(&g_processor.spectrum_queue, spectrum);  // cannot fail: pool size == queue size
+        spectrum = NULL;
+        __atomic_store_n(&g_processor.fft_busy, 0, __ATOMIC_SEQ_CST);
+    }
+
+    // Only the reduce stage may push to spectrum_free: keep the buffer for the next start
+    g_processor.fft_spectrum = spectrum;
+    return NULL;
+}
+
+// Reduce/publish: magnitudes into a frame slot, then publish
+static void* reduce_stage(void* arg) {
+    (void)arg;
+
+    while (stages_running()) {
+        void* item;
+        if (!spsc_queue_pop_wait(&g_processor.spectrum_queue, &item, MP_STAGE_WAIT_MS)) continue;
+
+        mp_spectrum_t* spectrum = (mp_spectrum_t*)item;
+        uint64_t prof_start = prof_begin();
+        reduce_spectrum(spectrum);
+        prof_end(PROF_STAGE_BANDS, prof_start);
+        __atomic_add_fetch(&g_processor.spectra_reduced, 1, __ATOMIC_SEQ_CST);
+        spsc_queue_push(&g_processor.spectrum_free, spectrum);
+    }
+    return NULL;
+}
+
+static void anchor_store(uint64_t write_count, uint64_t capture_ns) {
+    uint32_t seq = g_processor.anchor_seq;
+    __atomic_store_n(&g_processor.anchor_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&g_processor.anchor_count, write_count, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_processor.anchor_ns, capture_ns, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_processor.anchor_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// Capture time of the sample at sample_count, extrapolated from the latest anchor
+static uint64_t anchor_timestamp(uint64_t sample_count) {
+    uint32_t seq;
+    uint64_t count, ns;
+    do {
+        seq = __atomic_load_n(&g_processor.anchor_seq, __ATOMIC_ACQUIRE);
+        count = __atomic_load_n(&g_processor.anchor_count, __ATOMIC_RELAXED);
+        ns = __atomic_load_n(&g_processor.anchor_ns, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&g_processor.anchor_seq, __ATOMIC_RELAXED));
+
+    const uint64_t rate = (uint64_t)g_processor.config.sample_rate;
+    if (sample_count <= count) {
+        return ns - (count - sample_count) * 1000000000ull / rate;
+    }
+    return ns + (sample_count - count) * 1000000000ull / rate;
+}
+
+// Window + FFT of one ring-buffer window into `out`, plus the RMS of its newest hop. Returns -1 if the window
+// was overwritten by the convert stage before the analysis was done with it.
+static int process_fft(const float* window_data, uint64_t window_end, kiss_fft_cpx* out, float* rms) {
+    const int n = g_processor.config.fft_size;
+    const int hop = g_processor.config.hop_size;
+    ring_buffer_t* rb = g_processor.ring_buffer;
+
+    // Level of the samples this hop added (validated by the release below)
+    *rms = sqrtf(dsp_sumsq_f32(window_data + (n - hop), (size_t)hop) / (float)hop);
+
+    // Without a window the FFT reads the ring buffer in place; otherwise the
+    // window multiply is the only pass over the data
+    const float* fft_input = window_data;
+    bool released = false;
+    if (g_processor.window) {
+        dsp_mul_f32(g_processor.input_buffer, window_data, g_processor.window, (size_t)n);
+        fft_input = g_processor.input_buffer;
+        released = true;
+        if (!ring_buffer_release_window(rb, window_end, (size_t)n)) {
+            return -1;   // overwritten while copying
+        }
+    }
+
     // Perform FFT
-    ring_buffer_read_all(g_processor.ring_buffer, g_processor.input_buffer);
-    kiss_fftr(g_processor.fft_cfg, g_processor.input_buffer, g_processor.output_buffer);
+    kiss_fftr(g_processor.fft_cfg, fft_input, out);
+
+    if (!released && !ring_buffer_release_window(rb, window_end, (size_t)n)) {
+        return -1;       // overwritten while transforming
+    }
+    return 0;
+}
+
+static void reduce_spectrum(const mp_spectrum_t* spectrum) {
+    // Consumers may still hold older frames: write into a free slot
+    mp_frame_slot_t* slot = frame_begin_write();
+    if (!slot) {
+        __atomic_add_fetch(&g_processor.frames_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
     
-    // Calculate magnitude spectrum
-    float max_mag = 0.0f;
-    for (int i = 0; i < g_processor.config.fft_size/2 + 1; i++) {
-        float real = g_processor.output_buffer[i].r;
-        float imag = g_processor.output_buffer[i].i;
-        g_processor.magnitude[i] = sqrtf(real*real + imag*imag);
-        if (g_processor.magnitude[i] > max_mag) {
-            max_mag = g_processor.magnitude[i];
-        }
+    // Magnitude spectrum and its prefix sums in one pass
+    const int bins = g_processor.config.fft_size/2 + 1;
+    float* magnitude = slot->magnitude;
+    float* sum = slot->magnitude_sum;
+    sum[0] = 0.0f;
+    for (int i = 0; i < bins; i++) {
+        float real = spectrum->bins[i].r;
+        float imag = spectrum->bins[i].i;
+        magnitude[i] = sqrtf(real*real + imag*imag);
+        sum[i + 1] = sum[i] + magnitude[i];
     }
 
+    // Per-frame features: every consumer reads these instead of re-reducing the spectrum
+    mp_features_t* f = &slot->frame.features;
+    f->rms = spectrum->rms;
+    const int b0 = g_processor.bass_end, b1 = g_processor.mid_end, b2 = g_processor.treble_end;
+    f->bass = b0 > 0 ? sum[b0] / (float)b0 : 0.0f;
+    f->mid = b1 > b0 ? (sum[b1] - sum[b0]) / (float)(b1 - b0) : 0.0f;
+    f->treble = b2 > b1 ? (sum[b2] - sum[b1]) / (float)(b2 - b1) : 0.0f;
+    band_mapper_process(&g_processor.feature32, magnitude, f->bands32);
+    band_mapper_process(&g_processor.feature64, magnitude, f->bands64);
+    if (f->bands_count > 0) band_mapper_process(&g_processor.feature_n, magnitude, slot->bands);
+
+    scope_publish(slot, spectrum);
+
+    frame_publish(slot, spectrum->capture_ns);
+
     //display_spectrum() ;
-    
 }
 
-static void convert_samples_to_float(AVPacket* packet, float* output, int* num_samples) {
-    int16_t* input_samples = (int16_t*)packet->data;
-    *num_samples = packet->size / sizeof(int16_t);
+// Stage the newest hop of the window at the end of the scope history (FFT stage)
+static void scope_write_hop(const float* window_data) {
+    const int length = g_processor.config.scope_length;
+    const int hop = g_processor.config.hop_size;
+    if (length <= 0) return;
 
-    if (*num_samples > MP_BUFFER_SIZE) *num_samples = MP_BUFFER_SIZE;
+    // Keep the last two snapshots worth of samples when the history is full
+    if (g_processor.scope_history_len + hop > g_processor.scope_history_cap) {
+        const int keep = length * 2;
+        memmove(g_processor.scope_history,
+                g_processor.scope_history + g_processor.scope_history_len - keep,
+                (size_t)keep * sizeof(float));
+        g_processor.scope_history_len = keep;
+    }
+    memcpy(g_processor.scope_history + g_processor.scope_history_len,
+           window_data + (g_processor.config.fft_size - hop), (size_t)hop * sizeof(float));
+}
+
+static void scope_commit_hop(void) {
+    if (g_processor.config.scope_length <= 0) return;
+    g_processor.scope_history_len += g_processor.config.hop_size;
+}
+
+// Trigger-aligned copy of scope_length history samples. The trigger is searched
+// over the scope_length start positions before the newest possible one.
+static void scope_snapshot(mp_spectrum_t* spectrum) {
+    const int length = g_processor.config.scope_length;
+    if (length <= 0) return;
 
+    const float* history = g_processor.scope_history;
+    const int newest = g_processor.scope_history_len - length;
+    const int oldest = newest - length;
+    int start = newest;
+    int triggered = 0;
+
+    switch (g_processor.config.scope_trigger) {
+        case MP_SCOPE_TRIGGER_ZERO_CROSSING: {
+            bool armed = false;
+            for (int t = oldest; t <= newest; t++) {
+                if (history[t] < -MP_SCOPE_HYSTERESIS) {
+                    armed = true;
+                } else if (armed && history[t] >= 0.0f) {
+                    start = t;
+                    triggered = 1;
+                    armed = false;
+                }
+            }
+            break;
+        }
+        case MP_SCOPE_TRIGGER_PEAK: {
+            start = oldest;
+            for (int t = oldest + 1; t <= newest; t++) {
+                if (history[t] > history[start]) start = t;
+            }
+            triggered = 1;
+            break;
+        }
+        default:
+            break;
+    }
+
+    memcpy(spectrum->scope, history + start, (size_t)length * sizeof(float));
+    spectrum->scope_triggered = triggered;
+}
+
+// Copy the snapshot into the frame slot and build its min/max pyramid (reduce stage)
+static void scope_publish(mp_frame_slot_t* slot, const mp_spectrum_t* spectrum) {
+    const int length = g_processor.config.scope_length;
+    mp_scope_t* scope = &slot->frame.scope;
+    if (length <= 0) return;
+
+    memcpy(slot->scope_samples, spectrum->scope, (size_t)length * sizeof(float));
+    scope->triggered = spectrum->scope_triggered;
+
+    // Level 0 from pairs of samples, level l from pairs of level l-1 entries
+    const float* src_min = slot->scope_samples;
+    const float* src_max = slot->scope_samples;
+    float* dst_min = slot->scope_min;
+    float* dst_max = slot->scope_max;
+    int levels = 0;
+    for (int count = length >> 1; count > 0 && levels < MP_SCOPE_MAX_LEVELS; count >>= 1) {
+        for (int j = 0; j < count; j++) {
+            dst_min[j] = fminf(src_min[2*j], src_min[2*j + 1]);
+            dst_max[j] = fmaxf(src_max[2*j], src_max[2*j + 1]);
+        }
+        scope->min[levels] = dst_min;
+        scope->max[levels] = dst_max;
+        levels++;
+        src_min = dst_min;
+        src_max = dst_max;
+        dst_min += count;
+        dst_max += count;
+    }
+    scope->levels = levels;
+}
+
+static int hz_to_bin(float hz) {
+    int bin = (int)lroundf(hz * (float)g_processor.config.fft_size / (float)g_processor.config.sample_rate);
+    int bins = g_processor.config.fft_size/2 + 1;
+    if (bin < 0) bin = 0;
+    if (bin > bins) bin = bins;
+    return bin;
+}
+
+// Also called again by mp_start_recording() when the capture rate differs
+static int features_init(void) {
+    const int fft = g_processor.config.fft_size;
+    const int rate = g_processor.config.sample_rate;
+
+    band_mapper_free(&g_processor.feature32);
+    band_mapper_free(&g_processor.feature64);
+    band_mapper_free(&g_processor.feature_n);
+    g_processor.features_rate = 0;
+
+    g_processor.bass_end = hz_to_bin(MP_BASS_MAX_HZ);
+    g_processor.mid_end = hz_to_bin(MP_MID_MAX_HZ);
+    g_processor.treble_end = hz_to_bin(MP_TREBLE_MAX_HZ);
+
+    if (band_mapper_init(&g_processor.feature32, 32, fft, rate, BAND_SCALE_LOG, MP_BANDS_MIN_HZ, MP_BANDS_MAX_HZ, NULL) != 0 ||
+        band_mapper_init(&g_processor.feature64, 64, fft, rate, BAND_SCALE_LOG, MP_BANDS_MIN_HZ, MP_BANDS_MAX_HZ, NULL) != 0) {
+        return -1;
+    }
+    if (g_processor.config.feature_bands > 0 &&
+        band_mapper_init(&g_processor.feature_n, g_processor.config.feature_bands, fft, rate,
+                         BAND_SCALE_LOG, MP_BANDS_MIN_HZ, MP_BANDS_MAX_HZ, NULL) != 0) {
+        return -1;
+    }
+    g_processor.features_rate = rate;
+    return 0;
+}
+
+// Pick a slot that is neither the latest frame nor pinned by a consumer.
+// A consumer that races with us re-checks latest_slot after pinning, so it can
+// never end up holding a slot we are writing (see mp_acquire_frame).
+static mp_frame_slot_t* frame_begin_write(void) {
+    int latest = __atomic_load_n(&g_processor.latest_slot, __ATOMIC_SEQ_CST);
+    for (int n = 1; n <= MP_FRAME_SLOTS; n++) {
+        int i = (latest + n + MP_FRAME_SLOTS) % MP_FRAME_SLOTS;
+        if (i == latest) continue;
+        if (__atomic_load_n(&g_processor.slots[i].readers, __ATOMIC_SEQ_CST) == 0) {
+            return &g_processor.slots[i];
+        }
+    }
+    return NULL;
+}
+
+static void frame_publish(mp_frame_slot_t* slot, uint64_t capture_ns) {
+    slot->frame.seq = g_processor.frame_seq + 1;
+    slot->frame.timestamp_ns = capture_ns;
+
+    __atomic_store_n(&g_processor.latest_slot, (int)(slot - g_processor.slots), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&g_processor.frame_seq, slot->frame.seq, __ATOMIC_SEQ_CST);
+
+    // Frame-ready notification: skips the syscall when nobody is waiting
+    futex_event_signal(&g_processor.frame_event);
+}
+
+static uint64_t mp_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Convert a chunk of any size into the ring buffer, MP_BUFFER_SIZE frames at a time
+static void convert_chunk(const mp_chunk_t* chunk) {
     const float GAIN = 4.0f; // test 2.0 -> 4.0 -> 6.0
-    for (int i = 0; i < *num_samples; i++) {
-        float x = (float)input_samples[i] / 32768.0f;
-        x *= GAIN;
+    const int channels = chunk->channels > 0 ? chunk->channels : 1;
+    const int bytes = sample_format_bytes(chunk->format);
+    if (bytes == 0) return;
+
+    const int frames = chunk->size / (bytes * channels);
+    const size_t history = (size_t)(g_processor.config.fft_size - g_processor.config.hop_size);
+    const uint64_t rate = (uint64_t)g_processor.config.sample_rate;
+    float audio_samples[MP_BUFFER_SIZE];
 
-        if (x > 1.0f) x = 1.0f;
-        if (x < -1.0f) x = -1.0f;
+    for (int first = 0; first < frames; first += MP_BUFFER_SIZE) {
+        int count = frames - first < MP_BUFFER_SIZE ? frames - first : MP_BUFFER_SIZE;
+        sample_convert_mono(audio_samples, chunk->data, chunk->format, channels, frames,
+                            first, count, g_processor.config.analysis_channel, GAIN);
 
-        output[i] = x;
+        // Lossless: never overwrite samples the next FFT window still needs
+        while (g_processor.lossless && stages_running()) {
+            uint32_t seen = futex_event_snapshot(&g_processor.space_event);
+            if (ring_buffer_free_space(g_processor.ring_buffer, history) >= (size_t)count) break;
+            futex_event_wait(&g_processor.space_event, seen, MP_STAGE_WAIT_MS);
+        }
+
+        ring_buffer_write(g_processor.ring_buffer, audio_samples, count);
+        // capture_ns belongs to the chunk's last frame: back-date earlier blocks
+        uint64_t behind_ns = (uint64_t)(frames - first - count) * 1000000000ull / rate;
+        anchor_store(ring_buffer_write_count(g_processor.ring_buffer), chunk->capture_ns - behind_ns);
+        futex_event_signal(&g_processor.ring_event);
     }
 }
 
 
 static void display_spectrum() {
+    const mp_frame_t* frame = mp_acquire_frame();
+    if (!frame) return;
+    const float* magnitude = frame->magnitude;
+
     printf("\r");
     
     // Find max value to normalize
     float max_val = 0;
     for (int i = 1; i < 40; i++) { // Ignore bin 0 (DC component)
-        if (g_processor.magnitude[i] > max_val) {
-            max_val = g_processor.magnitude[i];
+        if (magnitude[i] > max_val) {
+            max_val = magnitude[i];
         }
     }
     
     // Display bars
     printf("Spectrum: [");
     for (int i = 1; i < 40; i++) {
-        float normalized = (max_val > 0) ? (g_processor.magnitude[i] / max_val) : 0;
+        float normalized = (max_val > 0) ? (magnitude[i] / max_val) : 0;
         int bar_height = (int)(normalized * 12);
         if (bar_height >= 12) printf("█");
         else if (bar_height >= 11) printf("▇");
@@ -322,63 +1395,161 @@ static void display_spectrum() {
     }
     printf("] Max: %.0f", max_val);
     fflush(stdout);
+
+    mp_release_frame(frame);
 }
 
-float* get_magnitude_data(void) {
-    return g_processor.magnitude;
+void mp_scope_minmax(const mp_scope_t* scope, int first, int last, float* min_out, float* max_out) {
+    if (first < 0) first = 0;
+    if (last > scope->length) last = scope->length;
+    if (!scope->samples || last <= first) {
+        *min_out = 0.0f;
+        *max_out = 0.0f;
+        return;
+    }
+
+    float lo = scope->samples[first];
+    float hi = lo;
+    while (first < last) {
+        // Largest pyramid block aligned at `first` that fits in the range
+        int level = -1;
+        while (level + 1 < scope->levels) {
+            int block = 2 << (level + 1);
+            if ((first & (block - 1)) != 0 || first + block > last) break;
+            level++;
+        }
+
+        if (level < 0) {
+            lo = fminf(lo, scope->samples[first]);
+            hi = fmaxf(hi, scope->samples[first]);
+            first++;
+        } else {
+            int j = first >> (level + 1);
+            lo = fminf(lo, scope->min[level][j]);
+            hi = fmaxf(hi, scope->max[level][j]);
+            first += 1 << (level + 1);
+        }
+    }
+    *min_out = lo;
+    *max_out = hi;
 }
 
-void mp_get_bands32(float out32[32]) {
-    if (!out32) return;
+const mp_frame_t* mp_acquire_frame(void) {
+    for (;;) {
+        int idx = __atomic_load_n(&g_processor.latest_slot, __ATOMIC_SEQ_CST);
+        if (idx < 0) return NULL;
+
+        mp_frame_slot_t* slot = &g_processor.slots[idx];
+        __atomic_add_fetch(&slot->readers, 1, __ATOMIC_SEQ_CST);
+
+        // Still the latest after pinning -> the writer can no longer pick this slot
+        if (__atomic_load_n(&g_processor.latest_slot, __ATOMIC_SEQ_CST) == idx) {
+            return &slot->frame;
+        }
+        __atomic_sub_fetch(&slot->readers, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+void mp_release_frame(const mp_frame_t* frame) {
+    if (!frame) return;
+    mp_frame_slot_t* slot = (mp_frame_slot_t*)frame;
+    __atomic_sub_fetch(&slot->readers, 1, __ATOMIC_SEQ_CST);
+}
 
-    const int N = g_processor.config.fft_size/2 + 1;
-    float* mag = g_processor.magnitude;
-    if (!mag) { memset(out32, 0, 32*sizeof(float)); return; }
+uint64_t mp_get_frame_seq(void) {
+    return __atomic_load_n(&g_processor.frame_seq, __ATOMIC_SEQ_CST);
+}
 
-    // Static smoothing state (EMA)
-    static int inited = 0;
-    static float smooth[32];
-    if (!inited) { memset(smooth, 0, sizeof(smooth)); inited = 1; }
+mp_stats_t mp_get_stats(void) {
+    mp_stats_t stats = {
+        .frames_published = mp_get_frame_seq(),
+        .frames_dropped = __atomic_load_n(&g_processor.frames_dropped, __ATOMIC_RELAXED),
+        .samples_dropped = ring_buffer_dropped(g_processor.ring_buffer),
+        .chunks_dropped = __atomic_load_n(&g_processor.chunks_dropped, __ATOMIC_RELAXED),
+        .replay_fps = g_processor.replay_fps,
+    };
+    return stats;
+}
 
-    // Chọn dải tần để nhìn đẹp: bỏ DC, chỉ lấy đến ~1/3 phổ (tùy bạn)
-    const int start_bin = 2;
-    int end_bin = (int)(N * 0.33f);
-    if (end_bin < start_bin + 32) end_bin = start_bin + 32;
-    if (end_bin > N-1) end_bin = N-1;
+uint64_t mp_wait_frame(uint64_t last_seq, int timeout_ms) {
+    uint64_t deadline_ns = mp_now_ns() + (uint64_t)(timeout_ms < 0 ? 0 : timeout_ms) * 1000000ull;
 
-    // Gom bin theo kiểu "gần log": band i lấy [b0..b1] tăng dần
-    float raw[32];
-    for (int i = 0; i < 32; i++) raw[i] = 0.0f;
+    for (;;) {
+        // Snapshot the event before the sequence number: a publish in between
+        // changes the event and makes the wait return immediately
+        uint32_t seen = futex_event_snapshot(&g_processor.frame_event);
+        uint64_t seq = mp_get_frame_seq();
+        if (seq != last_seq) return seq;
+
+        int wait_ms = -1;
+        if (timeout_ms >= 0) {
+            uint64_t now_ns = mp_now_ns();
+            if (now_ns >= deadline_ns) return seq;
+            wait_ms = (int)((deadline_ns - now_ns + 999999ull) / 1000000ull);
+        }
+        futex_event_wait(&g_processor.frame_event, seen, wait_ms);
+    }
+}
 
-    float span = (float)(end_bin - start_bin);
-    for (int i = 0; i < 32; i++) {
-        // mapping cong để bass nhiều detail hơn: t^2
-        float t0 = (float)i / 32.0f;
-        float t1 = (float)(i + 1) / 32.0f;
-        t0 = t0 * t0;
-        t1 = t1 * t1;
+void mp_get_bands32(float out32[32]) {
+    if (!out32) return;
 
-        int b0 = start_bin + (int)(t0 * span);
-        int b1 = start_bin + (int)(t1 * span);
-        if (b1 <= b0) b1 = b0 + 1;
-        if (b1 > end_bin) b1 = end_bin;
+    const mp_frame_t* frame = mp_acquire_frame();
+    if (!frame) { memset(out32, 0, 32*sizeof(float)); return; }
 
-        float sum = 0.0f;
-        for (int b = b0; b < b1; b++) sum += mag[b];
-        raw[i] = sum / (float)(b1 - b0);
+    memcpy(out32, frame->features.bands32, 32*sizeof(float));
+    mp_release_frame(frame);
+}
+
+int mp_get_bands(mp_bands_state_t* state, float* out, int bands_count) {
+    if (!out || bands_count <= 0 || !g_initialized) return -1;
+
+    const mp_frame_t* frame = mp_acquire_frame();
+    if (!frame) { memset(out, 0, (size_t)bands_count * sizeof(float)); return 0; }
+
+    // Precomputed on the processing thread
+    const float* precomputed = NULL;
+    if (bands_count == 32) precomputed = frame->features.bands32;
+    else if (bands_count == 64) precomputed = frame->features.bands64;
+    else if (bands_count == frame->features.bands_count) precomputed = frame->features.bands;
+    if (precomputed) {
+        memcpy(out, precomputed, (size_t)bands_count * sizeof(float));
+        mp_release_frame(frame);
+        return 0;
     }
 
-    // Normalize theo max (tránh chia 0)
-    float mx = 1e-9f;
-    for (int i = 0; i < 32; i++) if (raw[i] > mx) mx = raw[i];
+    if (!state) {
+        mp_release_frame(frame);
+        return -1;
+    }
 
-    // EMA smoothing + compress (sqrt) để nhìn đều hơn
-    const float a = 0.80f; // smoothing factor
-    for (int i = 0; i < 32; i++) {
-        float v = raw[i] / mx;          // 0..1
-        v = sqrtf(v);                   // nén động nhẹ
-        smooth[i] = a * smooth[i] + (1.0f - a) * v;
-        out32[i] = smooth[i];
+    int ret = 0;
+    band_mapper_t* m = &state->mapper;
+    if (m->bands != bands_count || state->sample_rate != g_processor.config.sample_rate) {
+        band_mapper_free(m);
+        ret = band_mapper_init(m, bands_count, g_processor.config.fft_size,
+                               g_processor.config.sample_rate, BAND_SCALE_LOG,
+                               MP_BANDS_MIN_HZ, MP_BANDS_MAX_HZ, NULL);
+        state->sample_rate = ret == 0 ? g_processor.config.sample_rate : 0;
+        state->frame_seq = 0;
     }
+    if (ret == 0) {
+        // Same frame again: repeat the last levels instead of advancing the EMA
+        if (frame->seq == state->frame_seq) {
+            memcpy(out, m->smooth, (size_t)bands_count * sizeof(float));
+        } else {
+            band_mapper_process(m, frame->magnitude, out);
+            state->frame_seq = frame->seq;
+        }
+    }
+
+    mp_release_frame(frame);
+    return ret;
 }
 
+void mp_bands_state_free(mp_bands_state_t* state) {
+    if (!state) return;
+    band_mapper_free(&state->mapper);
+    state->sample_rate = 0;
+    state->frame_seq = 0;
+}
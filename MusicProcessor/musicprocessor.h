@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <pthread.h>
+#include "band_mapper.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,7 +13,19 @@ extern "C" {
 #define MP_BUFFER_SIZE 1024
 #define MP_SAMPLE_RATE 44100
 #define MP_FFT_SIZE 1024
+#define MP_HOP_SIZE 512
 #define MP_MAX_FREQ_BINS 80
+#define MP_PERIOD_FRAMES 256
+#define MP_ALSA_BUFFER_FRAMES 1024
+#define MP_FEATURE_BANDS 48
+#define MP_SCOPE_LENGTH 2048
+#define MP_SCOPE_MAX_LEVELS 16
+#define MP_IMPULSE_INTERVAL_MS 500
+
+// Frequency split of the bass/mid/treble features
+#define MP_BASS_MAX_HZ 430.0f
+#define MP_MID_MAX_HZ 2580.0f
+#define MP_TREBLE_MAX_HZ 6460.0f
 
 // Error codes
 typedef enum {
@@ -27,16 +40,142 @@ typedef enum {
     MP_STATE_ERROR
 } mp_state_t;
 
+// Analysis window applied before the FFT
+typedef enum {
+    MP_WINDOW_RECTANGULAR = 0,
+    MP_WINDOW_HANN,
+    MP_WINDOW_HAMMING,
+    MP_WINDOW_BLACKMAN_HARRIS,
+    MP_WINDOW_FLAT_TOP
+} mp_window_t;
+
+// Audio capture backend, chosen at mp_init_with_config() time
+typedef enum {
+    MP_SOURCE_FFMPEG_ALSA = 0,   // libavdevice "alsa" demuxer (av_read_frame)
+    MP_SOURCE_ALSA_MMAP,         // native ALSA, mmap access, one period per read
+    MP_SOURCE_FILE,              // replay a file (device_name is the path)
+    MP_SOURCE_IMPULSE            // synthetic click train in real time, no device (latency tests)
+} mp_source_t;
+
+// MP_SOURCE_FILE: file format
+typedef enum {
+    MP_FILE_AUTO = 0,        // from the extension: .wav, .raw/.pcm/.s16, .f32, anything else -> FFmpeg
+    MP_FILE_WAV,             // RIFF/WAVE, PCM s16 or IEEE float32
+    MP_FILE_RAW_S16LE,       // headerless interleaved s16le (sample_rate/channels from the config)
+    MP_FILE_RAW_F32LE,       // headerless interleaved f32le (sample_rate/channels from the config)
+    MP_FILE_FFMPEG           // anything libavformat/libavcodec can decode
+} mp_file_format_t;
+
+// MP_SOURCE_FILE: replay speed
+typedef enum {
+    MP_PACING_REALTIME = 0,  // one period at a time at the file's sample rate
+    MP_PACING_FAST           // as fast as possible, lossless; reports the pipeline frame rate
+} mp_pacing_t;
+
+// Processing pipeline stages, each one runs in its own thread
+typedef enum {
+    MP_STAGE_CAPTURE = 0,    // thread calling processing_function(): packet capture
+    MP_STAGE_CONVERT,        // sample conversion into the ring buffer
+    MP_STAGE_FFT,            // window + FFT every hop_size samples
+    MP_STAGE_REDUCE,         // magnitude / band reduction and frame publication
+    MP_STAGE_COUNT
+} mp_stage_t;
+
+// Trigger of the time-domain scope snapshot
+typedef enum {
+    MP_SCOPE_TRIGGER_NONE = 0,       // free-running: the newest scope_length samples
+    MP_SCOPE_TRIGGER_ZERO_CROSSING,  // latest rising zero crossing (with hysteresis)
+    MP_SCOPE_TRIGGER_PEAK            // largest sample of the search range
+} mp_scope_trigger_t;
+
 // Configuration structure
 typedef struct {
     int sample_rate;
     int channels;
     int fft_size;
+    int hop_size;            // new samples between two FFTs (<= fft_size), e.g. 256/512
+    mp_window_t window;      // window function, coefficients are built once at init
     const char* device_name;
+    mp_source_t source;      // capture backend
+    int period_frames;       // MP_SOURCE_ALSA_MMAP: period size hint (capture latency)
+    int buffer_frames;       // MP_SOURCE_ALSA_MMAP: hardware buffer size hint
+    mp_file_format_t file_format; // MP_SOURCE_FILE
+    mp_pacing_t pacing;      // MP_SOURCE_FILE
+    int analysis_channel;    // channel fed to the FFT, -1 = average of all channels
+    int feature_bands;       // size of the configurable band set in mp_features_t, 0 = none
+    int stage_cpu[MP_STAGE_COUNT]; // CPU each stage thread is pinned to, -1 = no affinity
+    int scope_length;        // samples of the time-domain snapshot in mp_frame_t, 0 = none
+    mp_scope_trigger_t scope_trigger;
+    int impulse_interval_ms; // MP_SOURCE_IMPULSE: time between two clicks
 } mp_config_t;
 
+// Pipeline statistics
+typedef struct {
+    uint64_t frames_published;
+    uint64_t frames_dropped;   // analyzed but not published (slots pinned / window overwritten)
+    uint64_t samples_dropped;  // captured samples skipped because the analysis fell behind
+    uint64_t chunks_dropped;   // packets skipped by capture because conversion fell behind
+    double replay_fps;         // MP_SOURCE_FILE + MP_PACING_FAST: sustained frames/sec of the last replay
+} mp_stats_t;
+
+// Per-frame features, computed once on the processing thread for every consumer
+typedef struct {
+    float rms;               // RMS of the hop's new samples (after input gain, 0..1)
+    float bass;              // mean magnitude of the bins below MP_BASS_MAX_HZ
+    float mid;               // mean magnitude MP_BASS_MAX_HZ..MP_MID_MAX_HZ
+    float treble;            // mean magnitude MP_MID_MAX_HZ..MP_TREBLE_MAX_HZ
+    float bands32[32];       // log bands, normalized + smoothed (0..1), same as mp_get_bands32()
+    float bands64[64];       // log bands, normalized + smoothed (0..1)
+    int bands_count;         // mp_config_t.feature_bands
+    const float* bands;      // bands_count log bands, normalized + smoothed (0..1)
+    const float* magnitude_sum; // prefix sums, bins + 1 entries: magnitude_sum[b] = sum of magnitude[0..b-1]
+} mp_features_t;
+
+// Time-domain snapshot of the analyzed signal (after input gain, -1..1).
+// samples[0] is the trigger point, so consecutive frames line up like a scope.
+// min[l]/max[l] is a decimation pyramid: entry j of level l covers
+// samples[j << (l+1) .. (j+1) << (l+1)), there are length >> (l+1) entries.
+typedef struct {
+    int length;              // mp_config_t.scope_length, 0 when disabled
+    int triggered;           // 1 if samples[0] is a trigger point, 0 if free-running
+    const float* samples;
+    int levels;
+    const float* min[MP_SCOPE_MAX_LEVELS];
+    const float* max[MP_SCOPE_MAX_LEVELS];
+} mp_scope_t;
+
+// Spectrum frame published by the processing thread.
+// Obtain with mp_acquire_frame(); the data stays valid and unchanged until
+// the matching mp_release_frame(), no matter how many frames are produced meanwhile.
+typedef struct {
+    uint64_t seq;            // monotonic sequence number, starts at 1
+    uint64_t timestamp_ns;   // CLOCK_MONOTONIC time the newest sample was captured
+    int bins;                // number of magnitude values (fft_size/2 + 1)
+    const float* magnitude;  // magnitude spectrum
+    mp_features_t features;  // reductions of this spectrum
+    mp_scope_t scope;        // time-domain samples ending at (about) the same capture time
+} mp_frame_t;
+
+/**
+ * Sum of frame->magnitude[first_bin..last_bin) in O(1) through the prefix sums
+ */
+static inline float mp_frame_bin_sum(const mp_frame_t* frame, int first_bin, int last_bin) {
+    if (first_bin < 0) first_bin = 0;
+    if (last_bin > frame->bins) last_bin = frame->bins;
+    if (last_bin <= first_bin) return 0.0f;
+    return frame->features.magnitude_sum[last_bin] - frame->features.magnitude_sum[first_bin];
+}
+
 // Public API functions
 
+/**
+ * Min/max of scope->samples[first..last) through the decimation pyramid,
+ * O(log(last - first)). Drawing W columns costs O(W log N) instead of O(N).
+ * @param min_out Minimum (0 for an empty range)
+ * @param max_out Maximum (0 for an empty range)
+ */
+void mp_scope_minmax(const mp_scope_t* scope, int first, int last, float* min_out, float* max_out);
+
 /**
  * Initialize the music processor with default configuration
  * @return MP_SUCCESS on success, error code on failure
@@ -68,24 +207,73 @@ mp_result_t mp_stop_recording(void);
 void processing_function(void);
 
 /**
- * Get the latest magnitude spectrum data
- * @return Pointer to array of magnitude values (size: fft_size/2 + 1)
+ * Pin the most recently published spectrum frame (lock-free, never blocks the
+ * processing thread). Every successful call must be paired with mp_release_frame().
+ * @return Pointer to the frame, or NULL if no frame has been published yet
+ */
+const mp_frame_t* mp_acquire_frame(void);
+
+/**
+ * Release a frame obtained from mp_acquire_frame()
+ * @param frame Frame to release (NULL is ignored)
+ */
+void mp_release_frame(const mp_frame_t* frame);
+
+/**
+ * Sequence number of the most recently published frame
+ * @return Sequence number, 0 if no frame has been published yet
  */
-float* get_magnitude_data(void);
+uint64_t mp_get_frame_seq(void);
 
 /**
- * Convert current FFT magnitude into 32 bands normalized (0..1).
+ * Block until a frame newer than last_seq is published (futex based, the
+ * processing thread only issues a wake-up when somebody is waiting)
+ * @param last_seq Sequence number the caller has already consumed
+ * @param timeout_ms Maximum time to wait, negative to wait forever
+ * @return Sequence number of the latest frame (equals last_seq on timeout)
+ */
+uint64_t mp_wait_frame(uint64_t last_seq, int timeout_ms);
+
+/**
+ * Copy the latest frame's 32 log-spaced bands normalized (0..1).
  * Output:
  *  - out32[i] in [0..1]
  * Use this for LED matrix 8x32 (32 columns).
+ * The bands are computed once per frame on the processing thread
+ * (mp_frame_t.features.bands32); calling this costs a copy.
  */
 void mp_get_bands32(float out32[32]);
 
 /**
- * Generic bands helper (optional): map magnitude -> N bands normalized (0..1).
- * bands_count should be <= 64 (recommended). Returns 0 on success.
+ * Per-consumer state of mp_get_bands() for band counts the frames do not carry.
+ * Zero-initialize before the first call, release with mp_bands_state_free().
+ */
+typedef struct {
+    band_mapper_t mapper;    // tables + smoothing of this consumer only
+    int sample_rate;         // rate the tables were built for
+    uint64_t frame_seq;      // frame the smoothing last advanced on
+} mp_bands_state_t;
+
+/**
+ * Generic bands helper (optional): map magnitude -> N log-spaced bands normalized (0..1).
+ * 32, 64 and mp_config_t.feature_bands are copied from the frame features;
+ * other counts are mapped on the caller's thread with the caller's own state
+ * (tables rebuilt when bands_count or the sample rate changes, smoothing
+ * advanced once per frame). state may be NULL for the precomputed counts.
+ * Returns 0 on success.
+ */
+int mp_get_bands(mp_bands_state_t* state, float* out, int bands_count);
+
+/**
+ * Release the tables of an mp_get_bands() state
+ */
+void mp_bands_state_free(mp_bands_state_t* state);
+
+/**
+ * Get pipeline statistics
+ * @return Counters since mp_init_with_config()
  */
-int mp_get_bands(float* out, int bands_count);
+mp_stats_t mp_get_stats(void);
 
 /**
  * Cleanup and free all resources
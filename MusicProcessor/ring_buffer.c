@@ -2,42 +2,122 @@
 #include <stdlib.h>
 #include <string.h>
 
-bool ring_buffer_init(ring_buffer_t *rb, size_t size) {
+static bool ring_buffer_alloc(ring_buffer_t *rb, size_t size, bool mirrored) {
     if (!rb || size == 0) return false;
-    rb->buffer = (float*)calloc(size, sizeof(float));
-    if (!rb->buffer) return false;
     if(size > RING_BUFFER_MAX_SIZE) {
         rb->size = RING_BUFFER_MAX_SIZE;
     }else {
         rb->size = size;
     }
+    rb->buffer = (float*)calloc(mirrored ? rb->size * 2 : rb->size, sizeof(float));
+    if (!rb->buffer) return false;
     rb->current = 0;
+    rb->mirrored = mirrored;
+    rb->write_count = 0;
+    rb->write_reserve = 0;
+    rb->read_count = 0;
+    rb->dropped = 0;
     return true;
 }
 
+bool ring_buffer_init(ring_buffer_t *rb, size_t size) {
+    return ring_buffer_alloc(rb, size, false);
+}
+
+bool ring_buffer_init_mirrored(ring_buffer_t *rb, size_t size) {
+    return ring_buffer_alloc(rb, size, true);
+}
+
 void ring_buffer_free(ring_buffer_t *rb) {
     if (rb && rb->buffer) {
         free(rb->buffer);
         rb->buffer = NULL;
         rb->size = 0;
         rb->current = 0;
+        rb->mirrored = false;
+    }
+}
+
+// Copy len mẫu vào vị trí pos (pos + len <= size), ghi thêm bản sao nếu mirrored
+static void ring_buffer_copy_in(ring_buffer_t *rb, size_t pos, const ring_buffer_data_t *data, size_t len) {
+    memcpy(rb->buffer + pos, data, len * sizeof(ring_buffer_data_t));
+    if (rb->mirrored) {
+        memcpy(rb->buffer + rb->size + pos, data, len * sizeof(ring_buffer_data_t));
     }
 }
 
 size_t ring_buffer_write(ring_buffer_t *rb, const ring_buffer_data_t *data, size_t len) {
     if (!rb || !rb->buffer || !data || len == 0) return 0;
+    size_t written = len;
+    uint64_t count = rb->write_count + written;
+    // Chỉ giữ lại size mẫu mới nhất (vị trí ghi vẫn tiến theo write_count)
+    if (len > rb->size) {
+        rb->current = (rb->current + (len - rb->size)) % rb->size;
+        data += len - rb->size;
+        len = rb->size;
+    }
+    // Báo trước vùng sắp ghi để consumer phát hiện cửa sổ bị ghi đè giữa chừng
+    __atomic_store_n(&rb->write_reserve, count, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
     if(len > rb->size - rb->current) {
-        memcpy(rb->buffer + rb->current, data, (rb->size - rb->current) * sizeof(ring_buffer_data_t));
-        memcpy(rb->buffer, data + (rb->size - rb->current), (len - (rb->size - rb->current)) * sizeof(ring_buffer_data_t));
+        size_t head = rb->size - rb->current;
+        ring_buffer_copy_in(rb, rb->current, data, head);
+        ring_buffer_copy_in(rb, 0, data + head, len - head);
     } else {
-        memcpy(rb->buffer + rb->current, data, len * sizeof(ring_buffer_data_t));
+        ring_buffer_copy_in(rb, rb->current, data, len);
     }
     rb->current = (rb->current + len) % rb->size;
-    return len;
+    __atomic_store_n(&rb->write_count, count, __ATOMIC_RELEASE);
+    return written;
+}
+
+size_t ring_buffer_available(const ring_buffer_t *rb) {
+    if (!rb) return 0;
+    uint64_t w = __atomic_load_n(&rb->write_count, __ATOMIC_ACQUIRE);
+    uint64_t r = __atomic_load_n(&rb->read_count, __ATOMIC_ACQUIRE);
+    return (size_t)(w - r);
+}
+
+size_t ring_buffer_free_space(const ring_buffer_t *rb, size_t history) {
+    if (!rb) return 0;
+    uint64_t w = __atomic_load_n(&rb->write_count, __ATOMIC_ACQUIRE);
+    uint64_t r = __atomic_load_n(&rb->read_count, __ATOMIC_ACQUIRE);
+    uint64_t used = (w - r) + history;
+    return used >= rb->size ? 0 : (size_t)(rb->size - used);
+}
+
+uint64_t ring_buffer_write_count(const ring_buffer_t *rb) {
+    return rb ? __atomic_load_n(&rb->write_count, __ATOMIC_ACQUIRE) : 0;
+}
+
+const ring_buffer_data_t *ring_buffer_acquire_window(ring_buffer_t *rb, size_t hop, size_t len, uint64_t *end) {
+    if (!rb || !rb->buffer || !rb->mirrored || !end) return NULL;
+    if (hop == 0 || hop > len || len > rb->size) return NULL;
+
+    uint64_t w = __atomic_load_n(&rb->write_count, __ATOMIC_ACQUIRE);
+    uint64_t r = rb->read_count;
+    if (w - r < hop) return NULL;
+
+    uint64_t e = r + hop;
+    // Overrun: mẫu cũ nhất của cửa sổ đã bị ghi đè -> nhảy tới cửa sổ mới nhất
+    if (w + len - e > rb->size) {
+        __atomic_add_fetch(&rb->dropped, (w - hop) - r, __ATOMIC_RELAXED);
+        e = w;
+    }
+
+    *end = e;
+    return rb->buffer + (size_t)((e + rb->size - len) % rb->size);
+}
+
+bool ring_buffer_release_window(ring_buffer_t *rb, uint64_t end, size_t len) {
+    if (!rb) return false;
+    __atomic_store_n(&rb->read_count, end, __ATOMIC_RELEASE);
+    // Producer có thể đã bắt đầu ghi đè mẫu cũ nhất trong lúc consumer đang đọc
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint64_t reserve = __atomic_load_n(&rb->write_reserve, __ATOMIC_RELAXED);
+    return reserve + len - end <= rb->size;
 }
 
-void ring_buffer_read_all(ring_buffer_t *rb, ring_buffer_data_t *data) {
-    if (!rb || !rb->buffer || !data) return;
-    memcpy(data, rb->buffer + rb->current, (rb->size - rb->current) * sizeof(ring_buffer_data_t));
-    memcpy(data + (rb->size - rb->current), rb->buffer, rb->current * sizeof(ring_buffer_data_t));
+uint64_t ring_buffer_dropped(const ring_buffer_t *rb) {
+    return rb ? __atomic_load_n(&rb->dropped, __ATOMIC_RELAXED) : 0;
 }
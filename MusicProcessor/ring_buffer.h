@@ -15,20 +15,48 @@ extern "C" {
 typedef RING_BUFFER_DATA_TYPE ring_buffer_data_t;
 
 // Ring buffer struct
+// Dùng được như SPSC lock-free: 1 thread ghi (ring_buffer_write), 1 thread đọc
+// (ring_buffer_acquire_window / ring_buffer_release_window). Các bộ đếm mẫu là
+// 64-bit, tăng đơn điệu và được truy cập bằng atomic.
 typedef struct {
     ring_buffer_data_t *buffer;
     size_t size;      
     size_t current;         
+    bool mirrored;          // buffer có 2*size phần tử, nửa sau là bản sao của nửa đầu
+    uint64_t write_count;   // tổng số mẫu đã ghi xong (producer)
+    uint64_t write_reserve; // tổng số mẫu đã/đang ghi, >= write_count (producer)
+    uint64_t read_count;    // tổng số mẫu đã tiêu thụ (consumer)
+    uint64_t dropped;       // số mẫu bị ghi đè trước khi consumer kịp đọc (consumer ghi, đọc atomic từ thread bất kỳ)
 } ring_buffer_t;
 
 // Khởi tạo ring buffer
 bool ring_buffer_init(ring_buffer_t *rb, size_t size);
+// Khởi tạo ring buffer dạng mirrored: mỗi mẫu được ghi 2 lần (i và i + size)
+// để cửa sổ size mẫu gần nhất luôn nằm liền mạch trong bộ nhớ (xem ring_buffer_acquire_window)
+bool ring_buffer_init_mirrored(ring_buffer_t *rb, size_t size);
 // Giải phóng bộ nhớ
 void ring_buffer_free(ring_buffer_t *rb);
 // Đẩy dữ liệu vào buffer
 size_t ring_buffer_write(ring_buffer_t *rb, const ring_buffer_data_t *data, size_t len);
-// Đọc dữ liệu ra khỏi buffer
-void ring_buffer_read_all(ring_buffer_t *rb, ring_buffer_data_t *data);
+
+// --- SPSC API ---
+// Số mẫu mới chưa được consumer tiêu thụ
+size_t ring_buffer_available(const ring_buffer_t *rb);
+// Số mẫu producer có thể ghi mà không đè lên dữ liệu consumer còn cần:
+// các mẫu chưa đọc cộng thêm history mẫu ngay trước read_count (len - hop của cửa sổ)
+size_t ring_buffer_free_space(const ring_buffer_t *rb, size_t history);
+// Tổng số mẫu producer đã ghi xong
+uint64_t ring_buffer_write_count(const ring_buffer_t *rb);
+// Consumer: lấy hop mẫu tiếp theo. Trả về con trỏ tới len mẫu liên tiếp kết thúc
+// ở mẫu mới nhất của hop (chỉ với buffer mirrored, hop <= len <= size), hoặc NULL nếu
+// chưa đủ dữ liệu. *end nhận bộ đếm mẫu ngay sau cửa sổ. Nếu producer đã ghi đè dữ liệu
+// chưa đọc (overrun), consumer nhảy tới dữ liệu mới nhất và cộng số mẫu bỏ qua vào dropped.
+const ring_buffer_data_t *ring_buffer_acquire_window(ring_buffer_t *rb, size_t hop, size_t len, uint64_t *end);
+// Consumer: đánh dấu đã tiêu thụ tới end. Trả về false nếu producer đã ghi đè cửa sổ
+// trong lúc đang đọc (dữ liệu vừa dùng không còn nhất quán, nên bỏ kết quả).
+bool ring_buffer_release_window(ring_buffer_t *rb, uint64_t end, size_t len);
+// Tổng số mẫu bị bỏ qua do overrun
+uint64_t ring_buffer_dropped(const ring_buffer_t *rb);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,127 @@
+#include "sample_convert.h"
+#include <libavutil/samplefmt.h>
+#include "dsp.h"
+
+// Interleaved input is de-interleaved through a stack buffer of this many floats
+#define SAMPLE_CONVERT_SCRATCH 512
+
+int sample_format_bytes(sample_format_t fmt) {
+    switch (fmt) {
+        case SAMPLE_FORMAT_S16:
+        case SAMPLE_FORMAT_S16P: return 2;
+        case SAMPLE_FORMAT_S32:
+        case SAMPLE_FORMAT_S32P:
+        case SAMPLE_FORMAT_F32:
+        case SAMPLE_FORMAT_F32P: return 4;
+        default:                 return 0;
+    }
+}
+
+bool sample_format_is_planar(sample_format_t fmt) {
+    return fmt == SAMPLE_FORMAT_S16P || fmt == SAMPLE_FORMAT_S32P || fmt == SAMPLE_FORMAT_F32P;
+}
+
+sample_format_t sample_format_from_av(int av_sample_fmt) {
+    switch (av_sample_fmt) {
+        case AV_SAMPLE_FMT_S16:  return SAMPLE_FORMAT_S16;
+        case AV_SAMPLE_FMT_S32:  return SAMPLE_FORMAT_S32;
+        case AV_SAMPLE_FMT_FLT:  return SAMPLE_FORMAT_F32;
+        case AV_SAMPLE_FMT_S16P: return SAMPLE_FORMAT_S16P;
+        case AV_SAMPLE_FMT_S32P: return SAMPLE_FORMAT_S32P;
+        case AV_SAMPLE_FMT_FLTP: return SAMPLE_FORMAT_F32P;
+        default:                 return SAMPLE_FORMAT_UNKNOWN;
+    }
+}
+
+// n contiguous samples -> float * scale
+static void sample_convert_run(float *dst, const uint8_t *src, sample_format_t fmt, int n, float scale) {
+    switch (fmt) {
+        case SAMPLE_FORMAT_S16:
+        case SAMPLE_FORMAT_S16P:
+            dsp_s16_to_f32(dst, (const int16_t *)src, (size_t)n, scale * (1.0f / 32768.0f));
+            break;
+        case SAMPLE_FORMAT_S32:
+        case SAMPLE_FORMAT_S32P:
+            dsp_s32_to_f32(dst, (const int32_t *)src, (size_t)n, scale * (1.0f / 2147483648.0f));
+            break;
+        case SAMPLE_FORMAT_F32:
+        case SAMPLE_FORMAT_F32P:
+            dsp_scale_f32(dst, (const float *)src, (size_t)n, scale);
+            break;
+        default:
+            for (int i = 0; i < n; i++) dst[i] = 0.0f;
+            break;
+    }
+}
+
+static void sample_convert_planar(float *dst, const uint8_t *src, sample_format_t fmt, int channels,
+                                  int plane_frames, int first, int count, int channel, float gain) {
+    const size_t bytes = (size_t)sample_format_bytes(fmt);
+    const size_t plane_bytes = (size_t)plane_frames * bytes;
+    const uint8_t *start = src + (size_t)first * bytes;
+
+    if (channel >= 0) {
+        sample_convert_run(dst, start + (size_t)channel * plane_bytes, fmt, count, gain);
+        return;
+    }
+
+    // Downmix: first plane straight into dst, the others accumulated blockwise
+    const float scale = gain / (float)channels;
+    sample_convert_run(dst, start, fmt, count, scale);
+    float tmp[SAMPLE_CONVERT_SCRATCH];
+    for (int c = 1; c < channels; c++) {
+        const uint8_t *plane = start + (size_t)c * plane_bytes;
+        for (int i = 0; i < count; i += SAMPLE_CONVERT_SCRATCH) {
+            int n = count - i < SAMPLE_CONVERT_SCRATCH ? count - i : SAMPLE_CONVERT_SCRATCH;
+            sample_convert_run(tmp, plane + (size_t)i * bytes, fmt, n, scale);
+            dsp_add_f32(dst + i, tmp, (size_t)n);
+        }
+    }
+}
+
+static void sample_convert_interleaved(float *dst, const uint8_t *src, sample_format_t fmt, int channels,
+                                       int first, int count, int channel, float gain) {
+    const size_t frame_bytes = (size_t)sample_format_bytes(fmt) * (size_t)channels;
+    const uint8_t *start = src + (size_t)first * frame_bytes;
+
+    if (channels == 1) {
+        sample_convert_run(dst, start, fmt, count, gain);
+        return;
+    }
+
+    const float scale = channel < 0 ? gain / (float)channels : gain;
+    const int block = SAMPLE_CONVERT_SCRATCH / channels;
+    float tmp[SAMPLE_CONVERT_SCRATCH];
+    for (int i = 0; i < count; i += block) {
+        int n = count - i < block ? count - i : block;
+        sample_convert_run(tmp, start + (size_t)i * frame_bytes, fmt, n * channels, scale);
+
+        float *out = dst + i;
+        if (channel >= 0) {
+            for (int k = 0; k < n; k++) out[k] = tmp[k * channels + channel];
+        } else if (channels == 2) {
+            dsp_mix2_f32(out, tmp, (size_t)n);
+        } else {
+            for (int k = 0; k < n; k++) {
+                float sum = 0.0f;
+                for (int c = 0; c < channels; c++) sum += tmp[k * channels + c];
+                out[k] = sum;
+            }
+        }
+    }
+}
+
+void sample_convert_mono(float *dst, const void *src, sample_format_t fmt, int channels,
+                         int plane_frames, int first, int count, int channel, float gain) {
+    if (count <= 0) return;
+    if (channels < 1) channels = 1;
+    if (channels > SAMPLE_CONVERT_SCRATCH) channels = SAMPLE_CONVERT_SCRATCH;
+    if (channel >= channels) channel = -1;
+
+    if (sample_format_is_planar(fmt)) {
+        sample_convert_planar(dst, (const uint8_t *)src, fmt, channels, plane_frames, first, count, channel, gain);
+    } else {
+        sample_convert_interleaved(dst, (const uint8_t *)src, fmt, channels, first, count, channel, gain);
+    }
+    dsp_clamp_f32(dst, (size_t)count, -1.0f, 1.0f);
+}
@@ -0,0 +1,40 @@
+#ifndef SAMPLE_CONVERT_H
+#define SAMPLE_CONVERT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// PCM layouts the capture backends can hand to the pipeline.
+// Planar buffers store the channel planes back to back, plane_frames samples each.
+typedef enum {
+    SAMPLE_FORMAT_S16 = 0,
+    SAMPLE_FORMAT_S32,
+    SAMPLE_FORMAT_F32,
+    SAMPLE_FORMAT_S16P,
+    SAMPLE_FORMAT_S32P,
+    SAMPLE_FORMAT_F32P,
+    SAMPLE_FORMAT_UNKNOWN
+} sample_format_t;
+
+// Bytes per sample of one channel (0 for SAMPLE_FORMAT_UNKNOWN)
+int sample_format_bytes(sample_format_t fmt);
+bool sample_format_is_planar(sample_format_t fmt);
+
+// Map an FFmpeg AVSampleFormat value, SAMPLE_FORMAT_UNKNOWN if unsupported
+sample_format_t sample_format_from_av(int av_sample_fmt);
+
+// Convert frames [first, first + count) of `src` to mono float in [-1, 1]:
+// channel < 0 averages all channels, otherwise only that channel is used.
+// Samples are multiplied by gain before clamping.
+void sample_convert_mono(float *dst, const void *src, sample_format_t fmt, int channels,
+                         int plane_frames, int first, int count, int channel, float gain);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLE_CONVERT_H
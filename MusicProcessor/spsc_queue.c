@@ -0,0 +1,63 @@
+#include "spsc_queue.h"
+#include <stdlib.h>
+
+bool spsc_queue_init(spsc_queue_t *q, uint32_t capacity) {
+    if (!q || capacity == 0 || capacity > (1u << 30)) return false;
+    uint32_t cap = 1;
+    while (cap < capacity) cap <<= 1;
+
+    q->items = (void **)calloc(cap, sizeof(void *));
+    if (!q->items) return false;
+    q->capacity = cap;
+    q->head = 0;
+    q->tail = 0;
+    futex_event_init(&q->not_empty);
+    return true;
+}
+
+void spsc_queue_free(spsc_queue_t *q) {
+    if (!q) return;
+    free(q->items);
+    q->items = NULL;
+    q->capacity = 0;
+    q->head = 0;
+    q->tail = 0;
+}
+
+bool spsc_queue_push(spsc_queue_t *q, void *item) {
+    uint32_t head = q->head;
+    uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= q->capacity) return false;
+
+    q->items[head & (q->capacity - 1)] = item;
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    futex_event_signal(&q->not_empty);
+    return true;
+}
+
+bool spsc_queue_pop(spsc_queue_t *q, void **item) {
+    uint32_t tail = q->tail;
+    uint32_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    if (head == tail) return false;
+
+    *item = q->items[tail & (q->capacity - 1)];
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool spsc_queue_pop_wait(spsc_queue_t *q, void **item, int timeout_ms) {
+    uint32_t seen = futex_event_snapshot(&q->not_empty);
+    if (spsc_queue_pop(q, item)) return true;
+    futex_event_wait(&q->not_empty, seen, timeout_ms);
+    return spsc_queue_pop(q, item);
+}
+
+uint32_t spsc_queue_size(spsc_queue_t *q) {
+    uint32_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+void spsc_queue_wake(spsc_queue_t *q) {
+    futex_event_signal(&q->not_empty);
+}
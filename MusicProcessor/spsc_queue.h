@@ -0,0 +1,46 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "futex_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bounded lock-free single-producer/single-consumer queue of pointers.
+// Push never blocks (it fails when full); the consumer may sleep in
+// spsc_queue_pop_wait() until an item arrives.
+typedef struct {
+    void **items;
+    uint32_t capacity;      // power of two
+    uint32_t head;          // next slot to write (producer)
+    uint32_t tail;          // next slot to read (consumer)
+    futex_event_t not_empty;
+} spsc_queue_t;
+
+// capacity is rounded up to a power of two
+bool spsc_queue_init(spsc_queue_t *q, uint32_t capacity);
+void spsc_queue_free(spsc_queue_t *q);
+
+// Producer side. Returns false if the queue is full.
+bool spsc_queue_push(spsc_queue_t *q, void *item);
+
+// Consumer side. Returns false if the queue is empty.
+bool spsc_queue_pop(spsc_queue_t *q, void **item);
+
+// Consumer side: wait up to timeout_ms (< 0 = forever) for an item
+bool spsc_queue_pop_wait(spsc_queue_t *q, void **item, int timeout_ms);
+
+// Number of queued items (approximate when called from a third thread)
+uint32_t spsc_queue_size(spsc_queue_t *q);
+
+// Wake a consumer sleeping in spsc_queue_pop_wait() (e.g. on shutdown)
+void spsc_queue_wake(spsc_queue_t *q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,51 @@
+#include "prof_overlay.h"
+#include "profiler.h"
+#include <stdio.h>
+
+static lv_obj_t* g_label = NULL;
+static lv_timer_t* g_timer = NULL;
+
+static void overlay_update(lv_timer_t* timer) {
+    (void)timer;
+    char text[512];
+    int len = snprintf(text, sizeof(text), "%-11s %7s %7s %7s\n", "us", "p50", "p99", "max");
+
+    for (int s = 0; s < PROF_STAGE_COUNT && len < (int)sizeof(text); s++) {
+        prof_stats_t st = prof_get_stats((prof_stage_t)s);
+        len += snprintf(text + len, sizeof(text) - (size_t)len, "%-11s %7.0f %7.0f %7.0f\n",
+                        prof_stage_name((prof_stage_t)s), st.p50_us, st.p99_us, st.max_us);
+    }
+    lv_label_set_text(g_label, text);
+}
+
+int prof_overlay_create(void) {
+    if (g_label) return 0;
+
+    g_label = lv_label_create(lv_layer_top());
+    if (!g_label) return -1;
+    lv_obj_align(g_label, LV_ALIGN_TOP_RIGHT, -10, 10);
+    lv_obj_set_style_bg_color(g_label, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_bg_opa(g_label, LV_OPA_70, 0);
+    lv_obj_set_style_text_color(g_label, lv_color_hex(0x00FF00), 0);
+    lv_obj_set_style_pad_all(g_label, 6, 0);
+    lv_obj_clear_flag(g_label, LV_OBJ_FLAG_CLICKABLE);
+
+    g_timer = lv_timer_create(overlay_update, PROF_OVERLAY_PERIOD_MS, NULL);
+    if (!g_timer) {
+        prof_overlay_delete();
+        return -1;
+    }
+    overlay_update(g_timer);
+    return 0;
+}
+
+void prof_overlay_delete(void) {
+    if (g_timer) {
+        lv_timer_del(g_timer);
+        g_timer = NULL;
+    }
+    if (g_label) {
+        lv_obj_del(g_label);
+        g_label = NULL;
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef PROF_OVERLAY_H
+#define PROF_OVERLAY_H
+
+#include "lvgl/lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Overlay refresh period
+#define PROF_OVERLAY_PERIOD_MS 500
+
+/**
+ * Show the per-stage p50/p99/max table on lv_layer_top(), so it stays
+ * visible across page changes. Call with the LVGL lock held.
+ * @return 0 on success, -1 if the objects cannot be created
+ */
+int prof_overlay_create(void);
+
+/**
+ * Remove the overlay (LVGL lock held)
+ */
+void prof_overlay_delete(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROF_OVERLAY_H
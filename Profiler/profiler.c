@@ -0,0 +1,193 @@
+#include "profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Log-linear histogram over nanoseconds: values below PROF_SUB_BUCKETS get their
+// own bucket, every power of two above is split into PROF_SUB_BUCKETS buckets
+#define PROF_SUB_BITS 4
+#define PROF_SUB_BUCKETS (1 << PROF_SUB_BITS)
+#define PROF_OCTAVES 40   // up to 2^40 ns (~18 min), larger values land in the last bucket
+#define PROF_BUCKETS ((PROF_OCTAVES - PROF_SUB_BITS + 1) * PROF_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t buckets[PROF_BUCKETS];
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+} prof_histogram_t;
+
+typedef struct {
+    uint64_t start_ns;
+    uint64_t dur_ns;
+    uint32_t stage;
+} prof_event_t;
+
+bool g_prof_enabled = false;
+
+static prof_histogram_t g_hist[PROF_STAGE_COUNT];
+static prof_event_t* g_trace = NULL;   // PROF_TRACE_EVENTS entries, allocated by prof_enable()
+static uint64_t g_trace_next = 0;
+static uint64_t g_start_ns = 0;
+
+static const char* const g_stage_names[PROF_STAGE_COUNT] = {
+    [PROF_STAGE_CAPTURE] = "capture",
+    [PROF_STAGE_CONVERT] = "convert",
+    [PROF_STAGE_FFT] = "fft",
+    [PROF_STAGE_BANDS] = "bands",
+    [PROF_STAGE_PAGE_UPDATE] = "page_update",
+    [PROF_STAGE_RENDER] = "lvgl_render",
+    [PROF_STAGE_FLUSH] = "flush",
+    [PROF_STAGE_PHOTON_SDL] = "photon_sdl",
+    [PROF_STAGE_PHOTON_LED] = "photon_led",
+};
+
+static int bucket_index(uint64_t ns) {
+    if (ns < PROF_SUB_BUCKETS) return (int)ns;
+
+    int exp = 63 - __builtin_clzll(ns);
+    int sub = (int)(ns >> (exp - PROF_SUB_BITS)) & (PROF_SUB_BUCKETS - 1);
+    int index = (exp - PROF_SUB_BITS + 1) * PROF_SUB_BUCKETS + sub;
+    return index < PROF_BUCKETS ? index : PROF_BUCKETS - 1;
+}
+
+// Middle of the values falling into a bucket
+static double bucket_value(int index) {
+    if (index < PROF_SUB_BUCKETS) return (double)index;
+
+    int exp = index / PROF_SUB_BUCKETS + PROF_SUB_BITS - 1;
+    int sub = index % PROF_SUB_BUCKETS;
+    double width = (double)(1ull << (exp - PROF_SUB_BITS));
+    return (PROF_SUB_BUCKETS + sub + 0.5) * width;
+}
+
+void prof_enable(bool enable) {
+    if (enable && !g_trace) {
+        g_trace = (prof_event_t*)calloc(PROF_TRACE_EVENTS, sizeof(prof_event_t));
+        if (!g_trace) fprintf(stderr, "Profiler: no memory for the trace, histograms only\n");
+    }
+    if (enable && !g_start_ns) g_start_ns = prof_now_ns();
+    __atomic_store_n(&g_prof_enabled, enable, __ATOMIC_RELEASE);
+}
+
+void prof_reset(void) {
+    memset(g_hist, 0, sizeof(g_hist));
+    __atomic_store_n(&g_trace_next, 0, __ATOMIC_RELAXED);
+    g_start_ns = prof_now_ns();
+}
+
+void prof_end(prof_stage_t stage, uint64_t start_ns) {
+    if (!start_ns) return;
+    prof_record(stage, start_ns, prof_now_ns());
+}
+
+void prof_record(prof_stage_t stage, uint64_t start_ns, uint64_t end_ns) {
+    if (stage >= PROF_STAGE_COUNT || end_ns < start_ns) return;
+    if (!__atomic_load_n(&g_prof_enabled, __ATOMIC_RELAXED)) return;
+
+    uint64_t dur = end_ns - start_ns;
+    prof_histogram_t* h = &g_hist[stage];
+    __atomic_add_fetch(&h->buckets[bucket_index(dur)], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&h->sum_ns, dur, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&h->max_ns, __ATOMIC_RELAXED);
+    while (dur > max &&
+           !__atomic_compare_exchange_n(&h->max_ns, &max, dur, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    if (g_trace) {
+        uint64_t n = __atomic_fetch_add(&g_trace_next, 1, __ATOMIC_RELAXED);
+        prof_event_t* ev = &g_trace[n % PROF_TRACE_EVENTS];
+        ev->start_ns = start_ns;
+        ev->dur_ns = dur;
+        ev->stage = (uint32_t)stage;
+    }
+}
+
+prof_stats_t prof_get_stats(prof_stage_t stage) {
+    prof_stats_t stats = {0};
+    if (stage >= PROF_STAGE_COUNT) return stats;
+
+    const prof_histogram_t* h = &g_hist[stage];
+    uint64_t count = __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+    if (count == 0) return stats;
+
+    stats.count = count;
+    stats.mean_us = (double)__atomic_load_n(&h->sum_ns, __ATOMIC_RELAXED) / (double)count / 1000.0;
+    stats.max_us = (double)__atomic_load_n(&h->max_ns, __ATOMIC_RELAXED) / 1000.0;
+
+    // Ranks of p50/p99 (1-based), searched in one pass over the buckets
+    uint64_t rank50 = (count + 1) / 2;
+    uint64_t rank99 = count - count / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < PROF_BUCKETS && seen < rank99; i++) {
+        uint64_t n = __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+        if (!n) continue;
+        if (seen < rank50 && seen + n >= rank50) stats.p50_us = bucket_value(i) / 1000.0;
+        seen += n;
+        if (seen >= rank99) stats.p99_us = bucket_value(i) / 1000.0;
+    }
+
+    // The bucket midpoint may overshoot the exact maximum
+    if (stats.p50_us > stats.max_us) stats.p50_us = stats.max_us;
+    if (stats.p99_us > stats.max_us) stats.p99_us = stats.max_us;
+    return stats;
+}
+
+const char* prof_stage_name(prof_stage_t stage) {
+    return stage < PROF_STAGE_COUNT ? g_stage_names[stage] : "?";
+}
+
+static void dump_csv(FILE* f) {
+    fprintf(f, "stage,count,mean_us,p50_us,p99_us,max_us\n");
+    for (int s = 0; s < PROF_STAGE_COUNT; s++) {
+        prof_stats_t st = prof_get_stats((prof_stage_t)s);
+        fprintf(f, "%s,%llu,%.1f,%.1f,%.1f,%.1f\n", g_stage_names[s], (unsigned long long)st.count,
+                st.mean_us, st.p50_us, st.p99_us, st.max_us);
+    }
+}
+
+// Complete ("X") events, one track per stage; timestamps relative to prof_enable()
+static void dump_chrome_trace(FILE* f) {
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (int s = 0; s < PROF_STAGE_COUNT; s++) {
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                s ? ",\n" : "", s, g_stage_names[s]);
+    }
+
+    uint64_t total = __atomic_load_n(&g_trace_next, __ATOMIC_RELAXED);
+    uint64_t first = total > PROF_TRACE_EVENTS ? total - PROF_TRACE_EVENTS : 0;
+    for (uint64_t n = g_trace ? first : total; n < total; n++) {
+        const prof_event_t* ev = &g_trace[n % PROF_TRACE_EVENTS];
+        if (ev->stage >= PROF_STAGE_COUNT || ev->start_ns < g_start_ns) continue;
+
+        fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                g_stage_names[ev->stage], ev->stage,
+                (double)(ev->start_ns - g_start_ns) / 1000.0, (double)ev->dur_ns / 1000.0);
+    }
+    fprintf(f, "\n]}\n");
+}
+
+int prof_dump(const char* path, prof_format_t format) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        perror("Profiler: cannot write dump");
+        return -1;
+    }
+
+    if (format == PROF_FORMAT_CHROME_TRACE) dump_chrome_trace(f);
+    else dump_csv(f);
+
+    if (fclose(f) != 0) return -1;
+    return 0;
+}
+
+void prof_print(void) {
+    printf("%-12s %10s %10s %10s %10s %10s\n", "stage", "count", "mean_us", "p50_us", "p99_us", "max_us");
+    for (int s = 0; s < PROF_STAGE_COUNT; s++) {
+        prof_stats_t st = prof_get_stats((prof_stage_t)s);
+        printf("%-12s %10llu %10.1f %10.1f %10.1f %10.1f\n", g_stage_names[s], (unsigned long long)st.count,
+               st.mean_us, st.p50_us, st.p99_us, st.max_us);
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of raw events kept for the Chrome trace (oldest are overwritten)
+#define PROF_TRACE_EVENTS 65536
+
+// Instrumented stages, from the microphone to the screen
+typedef enum {
+    PROF_STAGE_CAPTURE = 0,  // one capture read (packet, ALSA period or file block), including the wait for data
+    PROF_STAGE_CONVERT,      // sample conversion of a captured chunk into the ring buffer
+    PROF_STAGE_FFT,          // window + FFT of one hop
+    PROF_STAGE_BANDS,        // magnitude / band reduction and frame publication
+    PROF_STAGE_PAGE_UPDATE,  // sub_page_main_function of the active page
+    PROF_STAGE_RENDER,       // lv_timer_handler / lv_refr_now (includes the flushes)
+    PROF_STAGE_FLUSH,        // display driver flush_cb
+    PROF_STAGE_PHOTON_SDL,   // latency: capture of the newest sample -> last SDL flush of the frame
+    PROF_STAGE_PHOTON_LED,   // latency: capture of the newest sample -> SPI write of the LED matrix
+    PROF_STAGE_COUNT
+} prof_stage_t;
+
+// Output of prof_dump()
+typedef enum {
+    PROF_FORMAT_CSV = 0,     // one summary line per stage
+    PROF_FORMAT_CHROME_TRACE // chrome://tracing / Perfetto JSON of the last PROF_TRACE_EVENTS events
+} prof_format_t;
+
+// Summary of one stage, durations in microseconds
+typedef struct {
+    uint64_t count;
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double max_us;
+} prof_stats_t;
+
+extern bool g_prof_enabled;
+
+/**
+ * Turn recording on or off (off by default, prof_begin()/prof_end() then cost one load)
+ */
+void prof_enable(bool enable);
+
+/**
+ * Clear the histograms and the trace
+ */
+void prof_reset(void);
+
+static inline uint64_t prof_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Start timestamp of a measured section
+ * @return CLOCK_MONOTONIC time in ns, 0 when profiling is disabled
+ */
+static inline uint64_t prof_begin(void) {
+    return __atomic_load_n(&g_prof_enabled, __ATOMIC_RELAXED) ? prof_now_ns() : 0;
+}
+
+/**
+ * Record a section started with prof_begin() (ignored if start_ns is 0).
+ * Lock-free, callable from any thread.
+ */
+void prof_end(prof_stage_t stage, uint64_t start_ns);
+
+/**
+ * Record a duration measured by the caller
+ */
+void prof_record(prof_stage_t stage, uint64_t start_ns, uint64_t end_ns);
+
+/**
+ * Stage summary from its histogram (log buckets, ~6% resolution)
+ */
+prof_stats_t prof_get_stats(prof_stage_t stage);
+
+/**
+ * Short display name of a stage
+ */
+const char* prof_stage_name(prof_stage_t stage);
+
+/**
+ * Write the collected data to a file
+ * @return 0 on success, -1 if the file cannot be written
+ */
+int prof_dump(const char* path, prof_format_t format);
+
+/**
+ * Print the stage summaries to stdout
+ */
+void prof_print(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILER_H
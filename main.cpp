@@ -5,6 +5,8 @@
 #include "MusicProcessor/musicprocessor.h"
 
 #include "LedMatrix/led.h"
+#include "Profiler/profiler.h"
+#include "Profiler/prof_overlay.h"
 
 #include <stdio.h>
 #include <unistd.h>
@@ -12,10 +14,60 @@
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
+#include <signal.h>
+
+/* UI thread re-checks the page state at least this often when audio stalls */
+#define UI_IDLE_POLL_MS         100
+/* Upper bound for the main loop sleep so input stays responsive */
+#define MAIN_LOOP_MAX_IDLE_MS   30
 
 pthread_mutex_t lvgl_mutex;
 mv_value_t value;
 
+/* Set by SIGINT/SIGTERM: the main loop exits and writes the profile */
+static volatile sig_atomic_t g_quit = 0;
+
+static void quit_handler(int sig) {
+    (void)sig;
+    g_quit = 1;
+}
+
+/* Profiling, from the environment:
+   MV_PROFILE=<file>      record stage timings, written on exit (.json: Chrome trace, otherwise CSV)
+   MV_PROFILE_OVERLAY=1   also show p50/p99/max on screen */
+static const char* profile_setup(void) {
+    const char* path = getenv("MV_PROFILE");
+    const char* overlay = getenv("MV_PROFILE_OVERLAY");
+    bool show_overlay = overlay && strcmp(overlay, "0") != 0;
+    if (!path && !show_overlay) return NULL;
+
+    prof_enable(true);
+    if (show_overlay) {
+        pthread_mutex_lock(&lvgl_mutex);
+        if (prof_overlay_create() != 0) printf("Warning: cannot create profiler overlay\n");
+        pthread_mutex_unlock(&lvgl_mutex);
+    }
+    return path;
+}
+
+static void profile_finish(const char* path) {
+    if (!g_prof_enabled) return;
+
+    prof_print();
+    if (!path) return;
+
+    size_t len = strlen(path);
+    prof_format_t format = (len >= 5 && strcmp(path + len - 5, ".json") == 0)
+        ? PROF_FORMAT_CHROME_TRACE : PROF_FORMAT_CSV;
+    if (prof_dump(path, format) == 0) printf("Profile written to %s\n", path);
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
 void* thread0(void* arg) {
     (void)arg;
     processing_function();   // vòng while RECORDING
@@ -24,20 +76,56 @@ void* thread0(void* arg) {
 
 void* thread1(void* arg) {
     (void)arg;
+    uint64_t last_seq = 0;
+    uint64_t last_render_ns = 0;
+    uint16_t max_fps = graphic_get_max_fps();
+    uint64_t min_interval_ns = max_fps ? 1000000000ull / max_fps : 0;
+
     while (1) {
+        /* Sleep until the audio thread publishes a new spectrum */
+        mp_wait_frame(last_seq, UI_IDLE_POLL_MS);
+
+        /* Frame-rate cap: frames arriving in between are coalesced */
+        uint64_t since_render_ns = monotonic_ns() - last_render_ns;
+        if (since_render_ns < min_interval_ns) {
+            usleep((useconds_t)((min_interval_ns - since_render_ns) / 1000));
+        }
+
+        /* Pin a consistent spectrum frame for the whole page update */
+        const mp_frame_t* frame = mp_acquire_frame();
+        bool rendered = false;
+
         pthread_mutex_lock(&lvgl_mutex);
         if (MusicVisualizerPage && MusicVisualizerPage->state == MV_PAGE_INIT) {
-            MusicVisualizerPage->sub_page_main_function(&value);
+            /* Skip duplicates: only redraw when a new frame was published */
+            if (frame && frame->seq != last_seq) {
+                value.value = frame->magnitude;
+                value.length = frame->bins;
+                value.frame = frame;
+                value.capture_ns = frame->timestamp_ns;
+                uint64_t prof_start = prof_begin();
+                MusicVisualizerPage->sub_page_main_function(&value);
+                prof_end(PROF_STAGE_PAGE_UPDATE, prof_start);
+                graphic_set_frame_capture_ns(value.capture_ns);
+                rendered = true;
+            }
         } else if (MusicVisualizerPage && MusicVisualizerPage->state == MV_PAGE_DEINIT) {
             MusicVisualizerPage->sub_page_deinit();
         }
         pthread_mutex_unlock(&lvgl_mutex);
-        usleep(50000); /* 50ms */
+
+        if (frame) last_seq = frame->seq;
+        mp_release_frame(frame);
+
+        if (rendered) {
+            last_render_ns = monotonic_ns();
+            graphic_request_render();
+        }
     }
     return NULL;
 }
 
-int main(void)
+int main(int argc, char** argv)
 {
     /* Init mutex for LVGL early */
     pthread_mutex_init(&lvgl_mutex, NULL);
@@ -51,11 +139,31 @@ int main(void)
 
     /* Create UI */
     mainpage_create(lv_scr_act());
+    const char* profile_path = profile_setup();
 
-    /* Init music processor + start recording */
-    mp_init();
-    value.value = get_magnitude_data();
-    printf("Magnitude data pointer first bin: %f\n", value.value[0]);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = quit_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    /* Init music processor + start recording.
+       Usage: musicvisualizer [file [--fast]] replays a file instead of the ALSA device,
+              musicvisualizer --impulse [interval_ms] feeds a synthetic click train (latency
+              test without a microphone, implies profiling so the latency is reported) */
+    mp_config_t mp_config = mp_get_default_config();
+    if (argc > 1 && strcmp(argv[1], "--impulse") == 0) {
+        mp_config.source = MP_SOURCE_IMPULSE;
+        if (argc > 2) mp_config.impulse_interval_ms = atoi(argv[2]);
+        prof_enable(true);
+    } else if (argc > 1) {
+        mp_config.source = MP_SOURCE_FILE;
+        mp_config.device_name = argv[1];
+        if (argc > 2 && strcmp(argv[2], "--fast") == 0) {
+            mp_config.pacing = MP_PACING_FAST;
+        }
+    }
+    mp_init_with_config(&mp_config);
     mp_start_recording();
 
     /* LED MATRIX INIT (SPI MAX7219) */
@@ -81,15 +189,27 @@ int main(void)
 
     /* Main loop */
     printf("Starting main loop... (Press Ctrl+C to exit)\n");
-    while (1) {
-        lv_tick_inc(5);
+    uint64_t last_tick_ns = monotonic_ns();
+    while (!g_quit) {
+        uint64_t now_ns = monotonic_ns();
+        uint32_t elapsed_ms = (uint32_t)((now_ns - last_tick_ns) / 1000000ull);
+        lv_tick_inc(elapsed_ms);
+        last_tick_ns += (uint64_t)elapsed_ms * 1000000ull;
 
         pthread_mutex_lock(&lvgl_mutex);
-        graphic_task_handler();
+        uint32_t idle_ms = graphic_task_handler();
         pthread_mutex_unlock(&lvgl_mutex);
 
-        usleep(5000); /* 5ms */
+        /* Sleep until LVGL has work again or the UI thread drew a new frame */
+        if (idle_ms > MAIN_LOOP_MAX_IDLE_MS) idle_ms = MAIN_LOOP_MAX_IDLE_MS;
+        if (graphic_wait_render_request(idle_ms)) {
+            pthread_mutex_lock(&lvgl_mutex);
+            graphic_render_now();
+            pthread_mutex_unlock(&lvgl_mutex);
+        }
     }
 
+    printf("Exiting...\n");
+    profile_finish(profile_path);
     return 0;
 }